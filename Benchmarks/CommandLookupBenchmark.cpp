@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+    CommandLookupBenchmark.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+// Times looking up the command for incoming CCs: the unordered_map of
+// command strings CommandMap used to be, with its XOR hash and the checks
+// LR_IPC_OUT made on each CC, against a flat table laid out as
+// MappingTable's (see MappingTable::Index_). Both are copied here so it
+// builds on its own; MappingTable needs most of JUCE. Not part of the JUCE
+// projects:
+//   c++ -std=c++14 -O2 -DNDEBUG Benchmarks/CommandLookupBenchmark.cpp
+//     -o lookup_benchmark
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  constexpr int kChannels = 4; // a profile spread over a few channels
+  constexpr int kControllers = 64; // mapped on each
+  constexpr size_t kLookups = 20000000;
+  constexpr unsigned short kNoCommand = 0xFFFFu;
+
+  // the key and hash CommandMap had
+  struct OldMessageID {
+    bool isCC;
+    int channel;
+    int data;
+
+    bool operator==(const OldMessageID& other) const noexcept {
+      return isCC == other.isCC && channel == other.channel && data == other.data;
+    }
+  };
+
+  struct OldHash {
+    size_t operator()(const OldMessageID& k) const noexcept {
+      return std::hash<bool>()(k.isCC) ^ std::hash<int>()(k.channel) ^
+        std::hash<int>()(k.data << 2);
+    }
+  };
+
+  // MappedCommand and the CC part of MappingTable's layout
+  struct Entry {
+    unsigned short command_id;
+    unsigned char command_class;
+    unsigned char cc_mode;
+    unsigned short transform_id;
+    unsigned short macro_id;
+  };
+  constexpr size_t kCCBase = 16 * 128;
+  constexpr size_t kTableSize = kCCBase + 16 * 16384 + 16 + 16 + 16 * 128;
+
+  inline size_t CCIndex(int channel, int controller) noexcept {
+    return kCCBase + (static_cast<size_t>((channel - 1) & 0xF) << 14) +
+      (static_cast<size_t>(controller) & 0x3FFFu);
+  }
+
+  double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void Report(const char* name, double seconds, size_t check) {
+    std::printf("%-12s %6.1f ns/lookup (%zu)\n", name, seconds * 1e9 / kLookups, check);
+  }
+}
+
+int main() {
+  std::vector<std::string> commands;
+  for (auto index = 0; index < kChannels * kControllers; ++index)
+    commands.push_back("ParameterNumber" + std::to_string(index));
+  const std::vector<std::string> next_prev_profile{"PrevPro", "NextPro"};
+
+  std::unordered_map<OldMessageID, std::string, OldHash> old_map;
+  std::vector<Entry> table(kTableSize, Entry{kNoCommand, 0, 0, 0, 0});
+  for (auto channel = 1; channel <= kChannels; ++channel)
+    for (auto controller = 0; controller < kControllers; ++controller) {
+      const auto id = (channel - 1) * kControllers + controller;
+      old_map[{true, channel, controller}] = commands[id];
+      table[CCIndex(channel, controller)] =
+        Entry{static_cast<unsigned short>(id), 1, 0, 0, 0};
+    }
+
+  // mostly mapped controllers, some not
+  std::mt19937 random{1};
+  std::vector<std::pair<int, int>> messages(4096);
+  for (auto& message : messages)
+    message = {1 + static_cast<int>(random() % kChannels),
+      static_cast<int>(random() % (kControllers + kControllers / 4))};
+
+  size_t check = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t index = 0; index < kLookups; ++index) {
+    const auto& message = messages[index & 4095];
+    const OldMessageID id{true, message.first, message.second};
+    // as LR_IPC_OUT::handleMidiCC checked each CC
+    if (old_map.find(id) == old_map.end() || old_map.at(id) == "Unmapped" ||
+      std::find(next_prev_profile.begin(), next_prev_profile.end(), old_map.at(id)) !=
+      next_prev_profile.end())
+      continue;
+    const auto command = old_map.at(id);
+    check += command.size();
+  }
+  Report("string map", SecondsSince(start), check);
+
+  check = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t index = 0; index < kLookups; ++index) {
+    const auto& message = messages[index & 4095];
+    const auto& entry = table[CCIndex(message.first, message.second)];
+    if (entry.command_id == kNoCommand || entry.command_class != 1)
+      continue;
+    check += commands[entry.command_id].size();
+  }
+  Report("flat table", SecondsSince(start), check);
+  return 0;
+}
\ No newline at end of file
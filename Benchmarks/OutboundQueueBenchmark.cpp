@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    OutboundQueueBenchmark.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+// Times writing fader values for the plugin: the line building LR_IPC_OUT
+// used to do for each value (copy the command, std::to_string, concatenate)
+// against OutboundQueue. Not part of the JUCE projects; from the repository
+// root build it with the sources it uses, in release mode, e.g.
+//   c++ -std=c++14 -O2 -DNDEBUG -IJuceLibraryCode -IJuceLibraryCode/modules
+//     Benchmarks/OutboundQueueBenchmark.cpp Source/OutboundQueue.cpp
+//     Source/LRCommands.cpp JuceLibraryCode/juce_core.cpp -o outbound_benchmark
+// (juce_core.mm and -framework Cocoa -framework IOKit on OS X)
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "../Source/LRCommands.h"
+#include "../Source/OutboundQueue.h"
+
+namespace {
+  constexpr size_t kCommands = 64; // distinct commands per flush, none merged
+  constexpr size_t kValues = 2000000;
+  size_t allocations = 0;
+
+  double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void Report(const char* name, double seconds, size_t allocated, size_t bytes) {
+    std::printf("%-14s %7.1f ns/value %9.2f allocations/value %10zu bytes\n", name,
+      seconds * 1e9 / kValues, static_cast<double>(allocated) / kValues, bytes);
+  }
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (auto* memory = std::malloc(size ? size : 1))
+    return memory;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+int main() {
+  const auto& commands = LRCommandList::LRStringList;
+  const auto value = [](size_t index) {
+    return static_cast<double>(index % 128) / 127.0;
+  };
+
+  // as LR_IPC_OUT::handleMidiCC was: a new line built for every value
+  std::string pending;
+  std::string sent;
+  size_t bytes = 0;
+  auto allocated = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t index = 0; index < kValues; ++index) {
+    auto line = commands[1 + index % kCommands];
+    line += ' ' + std::to_string(value(index)) + '\n';
+    pending += line;
+    if (index % kCommands == kCommands - 1) {
+      sent.swap(pending);
+      bytes += sent.size();
+      pending.clear();
+    }
+  }
+  Report("string lines", SecondsSince(start), allocations - allocated, bytes);
+
+  OutboundQueue queue;
+  queue.SetLimit(kCommands * 2, QUEUE_FULL_POLICY::DROP_NEWEST);
+  std::string out;
+  bytes = 0;
+  allocated = allocations;
+  start = std::chrono::steady_clock::now();
+  for (size_t index = 0; index < kValues; ++index) {
+    const auto command_id = 1 + index % kCommands;
+    queue.PushValue(commands[command_id], command_id, value(index));
+    if (index % kCommands == kCommands - 1) {
+      queue.Drain(out);
+      bytes += out.size();
+      out.clear();
+    }
+  }
+  Report("OutboundQueue", SecondsSince(start), allocations - allocated, bytes);
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+==============================================================================
+
+CC14Filter.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "CC14Filter.h"
+
+bool CC14_Message::ProcessMidi(unsigned short int control,
+  unsigned short int value, std::uint32_t time_ms) noexcept(ndebug) {
+  assert(value <= 0x7Fu);
+  const auto previous = last_msb_control_;
+  last_msb_control_ = kNone;
+  if (control < 32u) { // MSB
+    const auto bit = std::uint32_t{1u} << control;
+    msb_[control] = static_cast<unsigned char>(value & 0x7Fu);
+    if (IsPaired(control)) {
+      if (!(held_ & bit)) {
+        held_ |= bit;
+        held_time_ms_[control] = time_ms;
+        return true; // hold until the LSB arrives
+      }
+      // the MSB repeated without an LSB: two 7-bit controls after all
+      paired_ &= ~bit;
+      held_ &= ~bit;
+    }
+    last_msb_control_ = static_cast<unsigned char>(control);
+    return false; // unpaired MSBs go through as ordinary CCs
+  }
+  if (control < 64u) { // LSB
+    const auto msb_control = static_cast<unsigned char>(control - 32u);
+    // pair only when the LSB directly follows its own MSB, so unrelated
+    // controls in the 0-63 range aren't mistaken for halves of one value
+    if (!IsPaired(msb_control) && previous != msb_control)
+      return false;
+    paired_ |= std::uint32_t{1u} << msb_control;
+    held_ &= ~(std::uint32_t{1u} << msb_control);
+    ready_ = true;
+    ready_control_ = msb_control;
+    ready_lsb_ = static_cast<unsigned char>(value & 0x7Fu);
+    return true;
+  }
+  return false;
+}
+
+void CC14_Message::Clear() noexcept {
+  ready_ = false;
+}
+
+bool CC14_Message::ExpireMSB(std::uint32_t now_ms, std::uint32_t timeout_ms,
+  unsigned short int& control) noexcept {
+  for (unsigned short int index = 0u; index < 32u; ++index) {
+    const auto bit = std::uint32_t{1u} << index;
+    if ((held_ & bit) && now_ms - held_time_ms_[index] >= timeout_ms) {
+      held_ &= ~bit;
+      paired_ &= ~bit;
+      control = index;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CC14_Message::Reset() noexcept {
+  ready_ = false;
+  paired_ = 0u;
+  held_ = 0u;
+  last_msb_control_ = kNone;
+}
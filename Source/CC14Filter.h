@@ -0,0 +1,171 @@
+#pragma once
+/*
+==============================================================================
+
+CC14Filter.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include "NrpnMessage.h"
+#include "Utilities/Utilities.h"
+
+class CC14_Message {
+  // Decoder for standard 14-bit control change: CC 0-31 carry the MSB and
+  // CC 32-63 the LSB of the same control. A control is treated as 14-bit once
+  // an LSB directly follows its MSB; until then its MSB passes through as a
+  // plain 7-bit CC, so ordinary controllers that use CC 0-63 are unaffected.
+  // Once paired, the MSB is held until its LSB arrives and the two emit one
+  // value. An LSB on its own updates a paired control using the last MSB.
+  // Two independent 7-bit knobs on CC n and n+32 moved one after the other
+  // look like a pair too, so a control is unpaired again when its MSB repeats
+  // with no LSB between, or when a held MSB times out (see ExpireMSB).
+public:
+  CC14_Message() noexcept {};
+  ~CC14_Message() {};
+
+  // returns true if the message was consumed as part of a 14-bit pair
+  bool ProcessMidi(unsigned short int control, unsigned short int value,
+    std::uint32_t time_ms) noexcept(ndebug);
+  void Clear() noexcept;
+  // unpairs a control whose MSB has been held for timeout_ms, returning
+  // true and the control, whose MSB is then sent as a plain CC
+  bool ExpireMSB(std::uint32_t now_ms, std::uint32_t timeout_ms,
+    unsigned short int& control) noexcept;
+
+  inline bool IsReady() const noexcept {
+    return ready_;
+  };
+
+  // some MSB is waiting for its LSB
+  inline bool IsHolding() const noexcept {
+    return held_ != 0u;
+  };
+
+  inline unsigned short int GetMSB(unsigned short int control) const noexcept(ndebug) {
+    assert(control < 32u);
+    return msb_[control & 0x1Fu];
+  };
+
+  inline bool IsPaired(unsigned short int control) const noexcept {
+    return control < 32u && (paired_ >> control) & 1u;
+  };
+
+  // MSB controller number of the completed pair
+  inline unsigned short int GetControl() const noexcept {
+    return ready_control_;
+  };
+
+  inline unsigned short int GetValue() const noexcept {
+    return (msb_[ready_control_] << 7) + ready_lsb_;
+  };
+
+  // forget which controls have been seen as pairs
+  void Reset() noexcept;
+
+private:
+  static constexpr unsigned char kNone = 0xFFu;
+  bool ready_{false};
+  unsigned char ready_control_{0u};
+  unsigned char ready_lsb_{0u};
+  unsigned char last_msb_control_{kNone}; // unpaired MSB just received, if any
+  std::uint32_t paired_{0u}; // bit n set once CC n+32 has followed CC n
+  std::uint32_t held_{0u}; // bit n set while CC n waits for its LSB
+  std::array<std::uint32_t, 32> held_time_ms_{}; // when each held MSB arrived
+  std::array<unsigned char, 32> msb_{};
+};
+
+class CC14_Filter {
+  // one CC14_Message per (device, channel), see NRPN_Filter
+public:
+  static constexpr size_t kMaxDevices = NRPN_Filter::kMaxDevices;
+
+  CC14_Filter() noexcept {};
+  ~CC14_Filter() {};
+  inline bool ProcessMidi(size_t device, unsigned short int channel,
+    unsigned short int control, unsigned short int value, std::uint32_t time_ms)
+    noexcept(ndebug) {
+    auto& message = messages_[Index_(device, channel)];
+    const auto was_holding = message.IsHolding();
+    const auto ret_val = message.ProcessMidi(control, value, time_ms);
+    holding_ += message.IsHolding() - was_holding;
+    return ret_val;
+  };
+
+  inline void Clear(size_t device, unsigned short int channel) noexcept(ndebug) {
+    return messages_[Index_(device, channel)].Clear();
+  };
+
+  inline void ClearDevice(size_t device) noexcept(ndebug) {
+    for (unsigned short int channel = 1u; channel <= 16u; ++channel) {
+      auto& message = messages_[Index_(device, channel)];
+      holding_ -= message.IsHolding();
+      message.Reset();
+    }
+  };
+
+  // true if some channel holds an MSB for its LSB
+  inline bool AnyHeld() const noexcept {
+    return holding_ > 0;
+  };
+
+  // unpairs controls whose MSB has waited timeout_ms, calling
+  // emit(device, channel, control, msb) for each, see NRPN_Filter
+  template<typename Callback>
+  void ExpireHeld(std::uint32_t now_ms, std::uint32_t timeout_ms,
+    Callback&& emit) {
+    if (holding_ <= 0)
+      return;
+    for (size_t idx = 0; idx < messages_.size(); ++idx) {
+      auto& message = messages_[idx];
+      if (!message.IsHolding())
+        continue;
+      unsigned short int control;
+      while (message.ExpireMSB(now_ms, timeout_ms, control))
+        emit(idx >> 4, static_cast<unsigned short int>((idx & 0xFu) + 1u), control,
+          message.GetMSB(control));
+      holding_ -= !message.IsHolding();
+    }
+  };
+
+  inline bool IsReady(size_t device, unsigned short int channel) const
+    noexcept(ndebug) {
+    return messages_[Index_(device, channel)].IsReady();
+  };
+
+  inline unsigned short int GetValue(size_t device, unsigned short int channel)
+    const noexcept(ndebug) {
+    return messages_[Index_(device, channel)].GetValue();
+  };
+
+  inline unsigned short int GetControl(size_t device, unsigned short int channel)
+    const noexcept(ndebug) {
+    return messages_[Index_(device, channel)].GetControl();
+  };
+
+private:
+  static inline size_t Index_(size_t device, unsigned short int channel)
+    noexcept(ndebug) {
+    assert(device < kMaxDevices);
+    assert(channel - 1u < 16u);
+    return ((device % kMaxDevices) << 4) | ((channel - 1u) & 0xFu);
+  };
+
+  int holding_{0}; // channels holding an MSB
+  std::array<CC14_Message, kMaxDevices * 16> messages_;
+};
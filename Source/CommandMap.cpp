@@ -20,46 +20,492 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "CommandMap.h"
+#include <algorithm>
+#include <cmath>
 #include "LRCommands.h"
 
-CommandMap::CommandMap() noexcept {}
+const std::vector<std::string> CommandMap::CCModeNames = {"Absolute",
+  "Two's Complement", "Sign Magnitude", "Binary Offset"};
 
-void CommandMap::addCommandforMessage(unsigned int command, const MIDI_Message_ID& message) {
+const std::vector<std::string> MappingTable::CurveNames = {"Linear", "Log",
+  "S-Curve"};
+
+constexpr unsigned short MappingTable::kNoCommand;
+constexpr size_t MappingTable::kMaxMacroCommands;
+constexpr size_t MappingTable::kTableSize;
+constexpr unsigned short CommandMap::kNoCommand;
+constexpr size_t CommandMap::kMaxBanks;
+const MappedCommand MappingTable::kUnmapped{kNoCommand, COMMAND_CLASS::UNMAPPED,
+  CC_MODE::ABSOLUTE, 0, 0};
+
+namespace {
+  constexpr double kLogCurve = 9.0; // log1p(kLogCurve * x) / log1p(kLogCurve)
+
+  // ids every table knows: LRStringList, NextPrevProfile, then BankSelect
+  size_t BankSelectBase() noexcept {
+    return LRCommandList::LRStringList.size() + LRCommandList::NextPrevProfile.size();
+  }
+
+  size_t KnownCommands() noexcept {
+    return BankSelectBase() + LRCommandList::BankSelect.size();
+  }
+}
+
+MappingTable::MappingTable():
+  tables_(1, std::vector<MappedCommand>(kTableSize, kUnmapped)),
+  messages_by_command_(KnownCommands()) {}
+
+void MappingTable::addCommandforMessage(unsigned int command, const MIDI_Message_ID& message) {
     // adds a message to the message:command map, and its associated command to the
     // command:message map
-  if (command < LRCommandList::LRStringList.size()) {
-    message_map_[message] = LRCommandList::LRStringList[command];
-    command_string_map_.insert({LRCommandList::LRStringList[command], message});
+  Assign_(message, static_cast<unsigned short>(command));
+}
+
+void MappingTable::Assign_(const MIDI_Message_ID& message, unsigned short command_id) {
+  if (message.device >= tables_.size())
+    tables_.resize(message.device + 1u);
+  if (tables_[message.device].empty())
+    tables_[message.device].assign(kTableSize, kUnmapped);
+  auto& entry = *EditEntry_(message);
+  if (entry.command_id != kNoCommand)
+    Unlink_(message, entry.command_id);
+  entry = {command_id, ClassifyCommand_(command_id), CC_MODE::ABSOLUTE, 0, 0};
+  if (command_id >= messages_by_command_.size())
+    messages_by_command_.resize(command_id + 1u);
+  messages_by_command_[command_id].push_back(message);
+}
+
+void MappingTable::Unlink_(const MIDI_Message_ID& message,
+  unsigned short command_id) noexcept {
+  // order within a command's messages doesn't matter
+  auto& messages = messages_by_command_[command_id];
+  const auto found = std::find(messages.begin(), messages.end(), message);
+  if (found != messages.end()) {
+    *found = messages.back();
+    messages.pop_back();
   }
-  else
-    message_map_[message] = LRCommandList::NextPrevProfile[command - LRCommandList::LRStringList.size()];
 }
 
-std::vector<const MIDI_Message_ID*> CommandMap::getMessagesForCommand(const std::string& command) const {
-  std::vector<const MIDI_Message_ID*> mm;
-  const auto range = command_string_map_.equal_range(command);
-  for (auto it = range.first; it != range.second; ++it)
-    mm.push_back(&it->second);
-  return mm;
+const std::string& MappingTable::getCommandString(unsigned short command_id) const {
+  size_t id = command_id;
+  if (id < LRCommandList::LRStringList.size())
+    return LRCommandList::LRStringList[id];
+  id -= LRCommandList::LRStringList.size();
+  if (id < LRCommandList::NextPrevProfile.size())
+    return LRCommandList::NextPrevProfile[id];
+  id -= LRCommandList::NextPrevProfile.size();
+  if (id < LRCommandList::BankSelect.size())
+    return LRCommandList::BankSelect[id];
+  return extra_commands_.at(id - LRCommandList::BankSelect.size());
 }
 
-void CommandMap::toXMLDocument(juce::File& file) const {
-  if (message_map_.size()) {//don't bother if map is empty
-    // save the contents of the command map to an xml file
-    juce::XmlElement root{"settings"};
-    for (const auto& map_entry : message_map_) {
+unsigned short MappingTable::FindCommand_(const std::string& command) const {
+  // kNoCommand if the string has never been interned
+  const auto index = LRCommandList::getIndexOfCommand(command);
+  if (index != 0 || command == LRCommandList::LRStringList[0])
+    return static_cast<unsigned short>(index);
+  const auto found = std::find(extra_commands_.begin(), extra_commands_.end(), command);
+  if (found != extra_commands_.end())
+    return static_cast<unsigned short>(KnownCommands() + (found - extra_commands_.begin()));
+  return kNoCommand;
+}
+
+unsigned short MappingTable::InternCommand_(const std::string& command) {
+  const auto command_id = FindCommand_(command);
+  if (command_id != kNoCommand)
+    return command_id;
+  // not a command this version knows, keep it so it is still sent and saved
+  extra_commands_.push_back(command);
+  return static_cast<unsigned short>(KnownCommands() + extra_commands_.size() - 1);
+}
+
+COMMAND_CLASS MappingTable::ClassifyCommand_(unsigned short command_id) const noexcept {
+  if (command_id == 0) // "Unmapped"
+    return COMMAND_CLASS::UNMAPPED;
+  const size_t profile_id = command_id - LRCommandList::LRStringList.size();
+  if (command_id >= LRCommandList::LRStringList.size() &&
+    profile_id < LRCommandList::NextPrevProfile.size())
+    return COMMAND_CLASS::PROFILE_NAVIGATION;
+  if (command_id >= BankSelectBase() && command_id < KnownCommands())
+    return COMMAND_CLASS::BANK_SELECT;
+  return COMMAND_CLASS::LR_PARAMETER;
+}
+
+MIDI_Message_ID MappingTable::MessageAt_(size_t index) noexcept {
+  // inverse of Index_
+  if (index < kCCBase)
+    return {static_cast<int>(index >> 7) + 1, static_cast<int>(index & 0x7F),
+      MIDI_MSG_TYPE::NOTE};
+  if (index < kPitchBendBase) {
+    index -= kCCBase;
+    return {static_cast<int>(index >> 14) + 1, static_cast<int>(index & 0x3FFF),
+      MIDI_MSG_TYPE::CC};
+  }
+  if (index < kChannelPressureBase)
+    return {static_cast<int>(index - kPitchBendBase) + 1, 0, MIDI_MSG_TYPE::PITCHBEND};
+  if (index < kKeyPressureBase)
+    return {static_cast<int>(index - kChannelPressureBase) + 1, 0,
+      MIDI_MSG_TYPE::CHANNEL_PRESSURE};
+  index -= kKeyPressureBase;
+  return {static_cast<int>(index >> 7) + 1, static_cast<int>(index & 0x7F),
+    MIDI_MSG_TYPE::KEY_PRESSURE};
+}
+
+const ValueTransform& MappingTable::getTransform(const MIDI_Message_ID& message) const {
+  static const ValueTransform identity{};
+  const auto& entry = Entry_(message);
+  return entry.transform_id == 0 ? identity :
+    transforms_[entry.transform_id - 1]->transform;
+}
+
+void MappingTable::setTransform(const MIDI_Message_ID& message,
+  const ValueTransform& transform) {
+  auto* entry = EditEntry_(message);
+  if (entry == nullptr || entry->command_id == kNoCommand)
+    return;
+  entry->transform_id = transform.isIdentity() ? 0 :
+    InternTransform_(transform, static_cast<size_t>(message.maxValue()) + 1);
+}
+
+unsigned short MappingTable::InternTransform_(const ValueTransform& transform,
+  size_t size) {
+  // mappings with the same transform and resolution share a table
+  for (size_t id = 0; id < transforms_.size(); ++id)
+    if (transforms_[id]->transform == transform &&
+      transforms_[id]->table.size() == size)
+      return static_cast<unsigned short>(id + 1);
+  auto compiled = std::make_shared<CompiledTransform>();
+  compiled->transform = transform;
+  compiled->table.resize(size);
+  for (size_t index = 0; index < size; ++index) {
+    auto x = static_cast<double>(index) / (size - 1);
+    if (transform.invert)
+      x = 1.0 - x;
+    switch (transform.curve) {
+      case RESPONSE_CURVE::LINEAR:
+        break;
+      case RESPONSE_CURVE::LOG:
+        x = std::log1p(kLogCurve * x) / std::log1p(kLogCurve);
+        break;
+      case RESPONSE_CURVE::S_CURVE:
+        x = x * x * (3.0 - 2.0 * x);
+        break;
+    }
+    compiled->table[index] = transform.min + (transform.max - transform.min) * x;
+  }
+  transforms_.push_back(std::move(compiled));
+  return static_cast<unsigned short>(transforms_.size());
+}
+
+int MappingTable::midiValue(const MIDI_Message_ID& message, double lr_value) const {
+  const auto max_value = message.maxValue();
+  const auto& entry = Entry_(message);
+  if (entry.command_id == kNoCommand || entry.transform_id == 0)
+    return static_cast<int>(std::round(max_value * lr_value));
+  // every curve is monotonic, so the table can be searched; values outside
+  // the transform's range go to the nearer end of the travel
+  const auto& table = transforms_[entry.transform_id - 1]->table;
+  const auto rising = table.front() <= table.back();
+  const auto found = rising ?
+    std::lower_bound(table.begin(), table.end(), lr_value) :
+    std::lower_bound(table.begin(), table.end(), lr_value, std::greater<double>());
+  auto index = found - table.begin();
+  if (found == table.end())
+    --index;
+  else if (found != table.begin() &&
+    std::abs(*(found - 1) - lr_value) < std::abs(*found - lr_value))
+    --index;
+  return static_cast<int>(index);
+}
+
+std::vector<std::string> MappingTable::getMacro(const MIDI_Message_ID& message) const {
+  std::vector<std::string> commands;
+  for (const auto command_id : getMacroIds(Entry_(message)))
+    commands.push_back(getCommandString(command_id));
+  return commands;
+}
+
+void MappingTable::setMacro(const MIDI_Message_ID& message,
+  const std::vector<std::string>& commands) {
+  auto* entry = EditEntry_(message);
+  if (entry == nullptr || entry->command_id == kNoCommand)
+    return;
+  std::vector<unsigned short> macro;
+  for (const auto& command : commands) {
+    const auto command_id = InternCommand_(command);
+    if (ClassifyCommand_(command_id) == COMMAND_CLASS::LR_PARAMETER &&
+      macro.size() < kMaxMacroCommands)
+      macro.push_back(command_id);
+  }
+  if (macro.empty())
+    entry->macro_id = 0;
+  else if (entry->macro_id != 0) // this table is a private copy, reuse the slot
+    macros_[entry->macro_id - 1] = std::move(macro);
+  else {
+    macros_.push_back(std::move(macro));
+    entry->macro_id = static_cast<unsigned short>(macros_.size());
+  }
+}
+
+std::vector<MIDI_Message_ID> MappingTable::getMappedMessages() const {
+  std::vector<MIDI_Message_ID> messages;
+  for (const auto& command_messages : messages_by_command_)
+    messages.insert(messages.end(), command_messages.begin(), command_messages.end());
+  return messages;
+}
+
+void MappingTable::addToXml(juce::XmlElement& root, size_t bank,
+  const std::vector<juce::String>& device_names) const {
+  for (size_t device = 0; device < tables_.size(); ++device) {
+    const auto& table = tables_[device];
+    for (size_t index = 0; index < table.size(); ++index) {
+      const auto& entry = table[index];
+      if (entry.command_id == kNoCommand)
+        continue;
+      const auto message = MessageAt_(index);
       auto* setting = new juce::XmlElement{"setting"};
-      setting->setAttribute("channel", map_entry.first.channel);
-      if (map_entry.first.isCC)
-        setting->setAttribute("controller", map_entry.first.controller);
-      else
-        setting->setAttribute("note", map_entry.first.pitch);
-      setting->setAttribute("command_string", map_entry.second);
+      setting->setAttribute("channel", message.channel);
+      switch (message.msg_type) {
+        case MIDI_MSG_TYPE::NOTE:
+          setting->setAttribute("note", message.pitch);
+          break;
+        case MIDI_MSG_TYPE::CC:
+          setting->setAttribute("controller", message.controller);
+          break;
+        case MIDI_MSG_TYPE::PITCHBEND:
+          setting->setAttribute("pitchbend", 0);
+          break;
+        case MIDI_MSG_TYPE::CHANNEL_PRESSURE:
+          setting->setAttribute("channel_pressure", 0);
+          break;
+        case MIDI_MSG_TYPE::KEY_PRESSURE:
+          setting->setAttribute("key_pressure", message.pitch);
+          break;
+      }
+      setting->setAttribute("command_string", getCommandString(entry.command_id));
+      if (entry.cc_mode != CC_MODE::ABSOLUTE)
+        setting->setAttribute("cc_mode",
+          CommandMap::CCModeNames[static_cast<size_t>(entry.cc_mode)]);
+      if (entry.transform_id != 0) {
+        const auto& transform = transforms_[entry.transform_id - 1]->transform;
+        setting->setAttribute("min", transform.min);
+        setting->setAttribute("max", transform.max);
+        if (transform.invert)
+          setting->setAttribute("invert", 1);
+        if (transform.curve != RESPONSE_CURVE::LINEAR)
+          setting->setAttribute("curve",
+            CurveNames[static_cast<size_t>(transform.curve)]);
+      }
+      for (const auto command_id : getMacroIds(entry))
+        setting->createNewChildElement("command")->setAttribute("command_string",
+          getCommandString(command_id));
+      if (bank > 0) // older versions read every setting as bank 0
+        setting->setAttribute("bank", static_cast<int>(bank));
+      if (device > 0 && device < device_names.size())
+        setting->setAttribute("device", device_names[device]);
       root.addChildElement(setting);
     }
-    if (!root.writeToFile(file, ""))
-        // Give feedback if file-save doesn't work
-      juce::AlertWindow::showMessageBox(juce::AlertWindow::WarningIcon, "File Save Error",
-        "Unable to save file as specified. Please try again, and consider saving to a different location.");
   }
+}
+
+CommandMap::CommandMap():
+  banks_(1),
+  published_banks_{std::make_shared<const MappingTable>(banks_.front())},
+  bank_changed_(1, false),
+  published_{published_banks_.front()} {}
+
+void CommandMap::BeginBatch() {
+  writer_mutex_.lock();
+  ++batch_depth_;
+}
+
+void CommandMap::EndBatch() {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_, std::adopt_lock);
+  assert(batch_depth_ > 0);
+  if (--batch_depth_ == 0) {
+    Publish_();
+    // bank commands that came in during the batch
+    if (requested_bank_ != kNoBank || requested_steps_ != 0)
+      triggerAsyncUpdate();
+  }
+}
+
+void CommandMap::addBankListener(BankListener* listener) {
+  bank_listeners_.push_back(listener);
+}
+
+void CommandMap::setBankCount(size_t count) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  count = std::min(std::max(count, size_t{1}), kMaxBanks);
+  if (count == banks_.size())
+    return;
+  banks_.resize(count);
+  published_banks_.resize(count);
+  bank_changed_.resize(count, true);
+  if (active_bank_ >= count) {
+    active_bank_ = 0;
+    active_changed_ = true;
+  }
+  if (batch_depth_ == 0)
+    Publish_();
+}
+
+bool CommandMap::SelectBank(size_t bank) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  if (bank >= banks_.size() || bank == active_bank_)
+    return false;
+  active_bank_ = bank;
+  active_changed_ = true;
+  if (batch_depth_ == 0)
+    Publish_();
+  return true;
+}
+
+void CommandMap::QueueBankCommand(unsigned short command_id) {
+  // BankSelect is "Previous Bank", "Next Bank", then "Bank 1" onwards
+  const auto bank_command = command_id - BankSelectBase();
+  switch (bank_command) {
+    case 0:
+      --requested_steps_;
+      break;
+    case 1:
+      ++requested_steps_;
+      break;
+    default:
+      requested_steps_ = 0;
+      requested_bank_ = static_cast<int>(bank_command) - 2;
+  }
+  triggerAsyncUpdate();
+}
+
+void CommandMap::handleAsyncUpdate() {
+  std::shared_ptr<const MappingTable> previous;
+  std::shared_ptr<const MappingTable> next;
+  {
+    std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+    if (batch_depth_ > 0)
+      return; // EndBatch publishes, and triggers this again for bank commands
+    const auto count = static_cast<int>(banks_.size());
+    auto bank = requested_bank_.exchange(kNoBank);
+    const auto steps = requested_steps_.exchange(0);
+    if (bank >= count) // "Bank n" past the profile's banks does nothing
+      bank = kNoBank;
+    if (bank == kNoBank && steps == 0) {
+      Publish_();
+      return;
+    }
+    const auto start = bank == kNoBank ? static_cast<int>(active_bank_) : bank;
+    previous = published_banks_[active_bank_];
+    if (SelectBank(static_cast<size_t>(((start + steps) % count + count) % count)))
+      next = published_banks_[active_bank_];
+    else
+      Publish_();
+  }
+  if (next)
+    for (const auto& listener : bank_listeners_)
+      listener->bankSelected(*previous, *next);
+}
+
+unsigned short CommandMap::InternDevice(const juce::String& device_name) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  const auto found = std::find(device_names_.begin(), device_names_.end(), device_name);
+  if (found != device_names_.end())
+    return static_cast<unsigned short>(found - device_names_.begin());
+  device_names_.push_back(device_name);
+  return static_cast<unsigned short>(device_names_.size() - 1);
+}
+
+juce::String CommandMap::getDeviceName(unsigned short device) const {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  return device < device_names_.size() ? device_names_[device] : juce::String{};
+}
+
+void CommandMap::addCommandforMessage(unsigned int command,
+  const MIDI_Message_ID& message) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().addCommandforMessage(command, message);
+  Changed_();
+}
+
+void CommandMap::addCommandforMessage(const std::string& command,
+  const MIDI_Message_ID& message) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().addCommandforMessage(command, message);
+  Changed_();
+}
+
+void CommandMap::setCCMode(const MIDI_Message_ID& message, CC_MODE mode) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().setCCMode(message, mode);
+  Changed_();
+}
+
+void CommandMap::setTransform(const MIDI_Message_ID& message,
+  const ValueTransform& transform) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().setTransform(message, transform);
+  Changed_();
+}
+
+void CommandMap::setMacro(const MIDI_Message_ID& message,
+  const std::vector<std::string>& commands) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().setMacro(message, commands);
+  Changed_();
+}
+
+void CommandMap::removeMessage(const MIDI_Message_ID& message) {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  Working_().removeMessage(message);
+  Changed_();
+}
+
+void CommandMap::clearMap() {
+  std::lock_guard<std::recursive_mutex> lock(writer_mutex_);
+  banks_.resize(1);
+  banks_.front().clearMap();
+  published_banks_.resize(1);
+  bank_changed_.assign(1, true);
+  if (active_bank_ != 0) {
+    active_bank_ = 0;
+    active_changed_ = true;
+  }
+  if (batch_depth_ == 0)
+    Publish_();
+}
+
+void CommandMap::toXMLDocument(juce::File& file) const {
+  // save the contents of the command map to an xml file
+  juce::XmlElement root{"settings"};
+  for (size_t bank = 0; bank < banks_.size(); ++bank)
+    banks_[bank].addToXml(root, bank, device_names_);
+  if (root.getNumChildElements() == 0) //don't bother if map is empty
+    return;
+  if (!root.writeToFile(file, ""))
+      // Give feedback if file-save doesn't work
+    juce::AlertWindow::showMessageBox(juce::AlertWindow::WarningIcon, "File Save Error",
+      "Unable to save file as specified. Please try again, and consider saving to a different location.");
+}
+
+void CommandMap::Changed_() {
+  bank_changed_[active_bank_] = true;
+  if (batch_depth_ == 0)
+    triggerAsyncUpdate();
+}
+
+void CommandMap::Publish_() {
+  // copies of the edited banks replace their published ones, readers still
+  // holding an old copy keep it until they let go. selecting a bank only
+  // publishes its resident copy
+  auto republish = active_changed_;
+  for (size_t bank = 0; bank < banks_.size(); ++bank) {
+    if (bank_changed_[bank]) {
+      published_banks_[bank] = std::make_shared<const MappingTable>(banks_[bank]);
+      bank_changed_[bank] = false;
+      republish |= bank == active_bank_;
+    }
+  }
+  if (republish)
+    published_.publish(published_banks_[active_bank_]);
+  active_changed_ = false;
 }
\ No newline at end of file
@@ -23,42 +23,75 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef COMMANDMAP_H_INCLUDED
 #define COMMANDMAP_H_INCLUDED
 
+#include <algorithm>
+#include <cassert>
+#include <deque>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "Utilities/GSL.h"
+#include "Utilities/Utilities.h"
+
+enum class MIDI_MSG_TYPE {
+  NOTE, // data is the note number
+  CC, // data is the controller, >= 128 for NRPN
+  PITCHBEND, // data unused, value 0-16383
+  CHANNEL_PRESSURE, // data unused
+  KEY_PRESSURE // data is the note number
+};
 
 struct MIDI_Message_ID {
-  bool isCC;
+  MIDI_MSG_TYPE msg_type;
   int channel;
   union {
     int controller;
     int pitch;
     int data;
   };
+  unsigned short device; // CommandMap::InternDevice id, 0 for any device
 
   MIDI_Message_ID():
-    isCC(0),
+    msg_type(MIDI_MSG_TYPE::NOTE),
     channel(0),
-    data(0)
+    data(0),
+    device(0)
 
   {}
 
-  MIDI_Message_ID(int ch, int dat, bool iscc):
-    isCC(iscc),
+  MIDI_Message_ID(int ch, int dat, MIDI_MSG_TYPE type, unsigned short dev = 0):
+    msg_type(type),
     channel(ch),
-    data(dat) {}
+    data(dat),
+    device(dev) {}
+
+  bool isCC() const noexcept {
+    return msg_type == MIDI_MSG_TYPE::CC;
+  }
+
+  // largest value the message carries
+  int maxValue() const noexcept {
+    return (msg_type == MIDI_MSG_TYPE::PITCHBEND ||
+      (msg_type == MIDI_MSG_TYPE::CC && controller >= 128)) ? 16383 : 127;
+  }
 
   bool operator==(const MIDI_Message_ID& other) const noexcept {
-    return (isCC == other.isCC && channel == other.channel && data == other.data);
+    return (msg_type == other.msg_type && channel == other.channel &&
+      data == other.data && device == other.device);
   }
 
   bool operator<(const MIDI_Message_ID& other) const noexcept {
     if (channel < other.channel) return true;
     if (channel == other.channel) {
       if (data < other.data) return true;
-      if (data == other.data && isCC && !other.isCC) return true;
+      if (data == other.data) {
+        if (msg_type < other.msg_type) return true;
+        if (msg_type == other.msg_type && device < other.device) return true;
+      }
     }
     return false;
   }
@@ -69,16 +102,83 @@ namespace std {
   template <>
   struct hash<MIDI_Message_ID> {
     std::size_t operator()(const MIDI_Message_ID& k) const noexcept {
-      return std::hash<bool>()(k.isCC) ^ std::hash<int>()(k.channel) ^
-        std::hash<int>()(k.data << 2);
+      // pack the fields so messages on different channels don't collide
+      return std::hash<std::size_t>()((static_cast<std::size_t>(k.device) << 22) |
+        (static_cast<std::size_t>(k.msg_type) << 19) |
+        (static_cast<std::size_t>(k.channel & 0x1F) << 14) |
+        static_cast<std::size_t>(k.data & 0x3FFF));
     }
   };
 }
 
-class CommandMap {
+// what a mapped command does, decided when the mapping is made so incoming
+// messages need no string compares
+enum class COMMAND_CLASS : unsigned char {
+  UNMAPPED, // "Unmapped"
+  LR_PARAMETER, // sent to the Lightroom plugin
+  PROFILE_NAVIGATION, // "Previous Profile" or "Next Profile"
+  BANK_SELECT // one of LRCommandList::BankSelect
+};
+
+// how a CC's value is read: absolute, or the step of an endless encoder
+enum class CC_MODE : unsigned char {
+  ABSOLUTE,
+  TWOS_COMPLEMENT, // 1 is +1, 127 is -1
+  SIGN_MAGNITUDE, // bit 6 set for negative: 1 is +1, 65 is -1
+  BINARY_OFFSET // 64 is no change: 65 is +1, 63 is -1
+};
+
+enum class RESPONSE_CURVE : unsigned char {
+  LINEAR,
+  LOG, // quick at the bottom of the travel, fine at the top
+  S_CURVE // fine at both ends, quick through the middle
+};
+
+// how a mapping's MIDI value becomes the value sent to Lightroom, 0-1 of the
+// parameter's range. min may exceed max
+struct ValueTransform {
+  double min = 0.0; // sent for the bottom of the control's travel
+  double max = 1.0; // sent for the top
+  bool invert = false; // the top of the travel sends min
+  RESPONSE_CURVE curve = RESPONSE_CURVE::LINEAR;
+
+  bool isIdentity() const noexcept {
+    return min == 0.0 && max == 1.0 && !invert && curve == RESPONSE_CURVE::LINEAR;
+  }
+
+  bool operator==(const ValueTransform& other) const noexcept {
+    return min == other.min && max == other.max && invert == other.invert &&
+      curve == other.curve;
+  }
+};
+
+// one entry of the message:command table
+struct MappedCommand {
+  unsigned short command_id; // see MappingTable::getCommandString
+  COMMAND_CLASS command_class;
+  CC_MODE cc_mode;
+  unsigned short transform_id; // 0 for none, else MappingTable::transforms_[id - 1]
+  unsigned short macro_id; // 0 for none, else MappingTable::macros_[id - 1]
+};
+
+class MappingTable {
+  // Commands are interned to ids: LRStringList indices first, then
+  // NextPrevProfile and BankSelect, then any other command string met in a
+  // profile. The message:command map is a flat table with a slot for every
+  // address each message kind can have, so a lookup is one indexed load.
+  // Mappings for one device only are kept in a table of their own, made when
+  // the device's first mapping is.
+  // Value transforms are evaluated for every MIDI value when set, so applying
+  // one is one more indexed load. A macro is the ids of the commands sent
+  // after the mapped one, kept together for the message; the whole macro fires
+  // once per press, or as a control reaches its top. The reverse index
+  // keeps the messages for each command id in one vector, updated as mappings
+  // change, so feedback from Lightroom is routed without allocating.
 public:
-  CommandMap() noexcept;
-  virtual ~CommandMap() {}
+  static constexpr unsigned short kNoCommand = 0xFFFFu;
+  static constexpr size_t kMaxMacroCommands = 16;
+
+  MappingTable();
 
 // adds an entry to the message:command map, and a corresponding entry to the
 // command:message map will look up the string by the index (but it is preferred to
@@ -92,6 +192,45 @@ class CommandMap {
   // gets the LR command associated to a MIDI message
   const std::string& getCommandforMessage(const MIDI_Message_ID& message) const;
 
+  // command and class for a MIDI message in one lookup, nullptr if not mapped
+  const MappedCommand* findCommand(const MIDI_Message_ID& message) const
+    noexcept(ndebug);
+
+  // as findCommand for a message from message.device, falling back to the
+  // mapping for any device; message.device is then cleared so message is the
+  // mapping's key
+  const MappedCommand* resolveCommand(MIDI_Message_ID& message) const
+    noexcept(ndebug);
+
+  // string for an interned command id
+  const std::string& getCommandString(unsigned short command_id) const;
+
+  // how a mapped CC's value is read, ABSOLUTE unless set
+  CC_MODE getCCMode(const MIDI_Message_ID& message) const;
+  void setCCMode(const MIDI_Message_ID& message, CC_MODE mode);
+
+  // value transform of a mapped message, compiled for the message's
+  // resolution when set
+  const ValueTransform& getTransform(const MIDI_Message_ID& message) const;
+  void setTransform(const MIDI_Message_ID& message, const ValueTransform& transform);
+
+  // value sent to Lightroom for a MIDI value of a mapped message
+  double lrValue(const MappedCommand& entry, int value, int max_value) const
+    noexcept(ndebug);
+
+  // MIDI value, 0 to message.maxValue(), nearest to a Lightroom value; for
+  // feedback to the control
+  int midiValue(const MIDI_Message_ID& message, double lr_value) const;
+
+  // Lightroom commands sent, in order, after a mapped message's command. only
+  // commands sent to Lightroom are kept, up to kMaxMacroCommands
+  std::vector<std::string> getMacro(const MIDI_Message_ID& message) const;
+  void setMacro(const MIDI_Message_ID& message, const std::vector<std::string>& commands);
+  gsl::span<const unsigned short> getMacroIds(const MappedCommand& entry) const noexcept;
+
+  // names used for RESPONSE_CURVE in profiles and menus
+  static const std::vector<std::string> CurveNames;
+
   // in the command:message map
   // removes a MIDI message from the message:command map, and it's associated entry
   void removeMessage(const MIDI_Message_ID& message);
@@ -102,47 +241,362 @@ class CommandMap {
   // returns true if there is a mapping for a particular MIDI message
   bool messageExistsInMap(const MIDI_Message_ID& message) const;
 
-  std::vector<const MIDI_Message_ID*> getMessagesForCommand(const std::string& command) const;
-  // gets the MIDI message associated to a LR command
+  // gets the MIDI messages associated to a LR command. the span is valid until
+  // this table is next changed
+  gsl::span<const MIDI_Message_ID> getMessagesForCommand(const std::string& command) const;
+  gsl::span<const MIDI_Message_ID> getMessagesForCommand(unsigned short command_id) const
+    noexcept;
 
   // returns true if there is a mapping for a particular LR command
   bool commandHasAssociatedMessage(const std::string& command) const;
 
-  // saves the message:command map as an XML file
-  void toXMLDocument(juce::File& file) const;
+  // every message with a mapping, including those to "Unmapped"
+  std::vector<MIDI_Message_ID> getMappedMessages() const;
+
+  // command ids run from 0 to commandCount() - 1
+  size_t commandCount() const noexcept;
+
+  // appends a setting element for each mapping to a profile's root element;
+  // device_names is indexed by device id
+  void addToXml(juce::XmlElement& root, size_t bank,
+    const std::vector<juce::String>& device_names) const;
 
 private:
+  // table layout: a block of 16 channels per message kind; CC blocks are
+  // sized for NRPN numbers, 7-bit controllers use the first 128 of each
+  static constexpr size_t kNoteBase = 0;
+  static constexpr size_t kCCBase = kNoteBase + 16 * 128;
+  static constexpr size_t kPitchBendBase = kCCBase + 16 * 16384;
+  static constexpr size_t kChannelPressureBase = kPitchBendBase + 16;
+  static constexpr size_t kKeyPressureBase = kChannelPressureBase + 16;
+  static constexpr size_t kTableSize = kKeyPressureBase + 16 * 128;
+
+  static const MappedCommand kUnmapped;
+
+  static size_t Index_(const MIDI_Message_ID& message) noexcept(ndebug);
+  static MIDI_Message_ID MessageAt_(size_t index) noexcept;
+  // the message's slot, kUnmapped if its device has no table
+  const MappedCommand& Entry_(const MIDI_Message_ID& message) const noexcept(ndebug);
+  // nullptr if the message's device has no table
+  MappedCommand* EditEntry_(const MIDI_Message_ID& message) noexcept(ndebug);
+  unsigned short FindCommand_(const std::string& command) const;
+  unsigned short InternCommand_(const std::string& command);
+  void Assign_(const MIDI_Message_ID& message, unsigned short command_id);
+  void Unlink_(const MIDI_Message_ID& message, unsigned short command_id) noexcept;
+  COMMAND_CLASS ClassifyCommand_(unsigned short command_id) const noexcept;
+  unsigned short InternTransform_(const ValueTransform& transform, size_t size);
+
+  // a transform evaluated at each of size MIDI values
+  struct CompiledTransform {
+    ValueTransform transform;
+    std::vector<double> table; // Lightroom value by MIDI value
+  };
 
-  std::unordered_map<MIDI_Message_ID, std::string> message_map_;
-  std::multimap<std::string, MIDI_Message_ID> command_string_map_;
+  // by device id; the first, for any device, is always made
+  std::vector<std::vector<MappedCommand>> tables_;
+  std::deque<std::string> extra_commands_; // stable references for events
+  std::vector<std::vector<MIDI_Message_ID>> messages_by_command_; // by command id
+  // shared by the copies published to readers
+  std::vector<std::shared_ptr<const CompiledTransform>> transforms_;
+  std::vector<std::vector<unsigned short>> macros_;
 };
 
-inline void CommandMap::addCommandforMessage(const std::string& command, const MIDI_Message_ID& message) {
-  message_map_[message] = command;
-  command_string_map_.insert({command, message});
+inline size_t MappingTable::Index_(const MIDI_Message_ID& message) noexcept(ndebug) {
+  // base and data bits for each MIDI_MSG_TYPE, in enum order
+  static constexpr size_t kBase[] = {kNoteBase, kCCBase, kPitchBendBase,
+    kChannelPressureBase, kKeyPressureBase};
+  static constexpr unsigned int kDataBits[] = {7u, 14u, 0u, 0u, 7u};
+  const auto type = static_cast<size_t>(message.msg_type);
+  assert(message.channel - 1u < 16u);
+  const auto bits = kDataBits[type];
+  return kBase[type] + (static_cast<size_t>((message.channel - 1) & 0xF) << bits) +
+    (static_cast<size_t>(message.data) & ((size_t{1} << bits) - 1u));
 }
 
-inline const std::string& CommandMap::getCommandforMessage(const MIDI_Message_ID& message) const {
-  return message_map_.at(message);
+inline void MappingTable::addCommandforMessage(const std::string& command, const MIDI_Message_ID& message) {
+  Assign_(message, InternCommand_(command));
 }
 
-inline void CommandMap::removeMessage(const MIDI_Message_ID& message) {
+inline const MappedCommand& MappingTable::Entry_(const MIDI_Message_ID& message) const
+noexcept(ndebug) {
+  if (message.device >= tables_.size() || tables_[message.device].empty())
+    return kUnmapped;
+  return tables_[message.device][Index_(message)];
+}
+
+inline MappedCommand* MappingTable::EditEntry_(const MIDI_Message_ID& message)
+noexcept(ndebug) {
+  if (message.device >= tables_.size() || tables_[message.device].empty())
+    return nullptr;
+  return &tables_[message.device][Index_(message)];
+}
+
+inline const std::string& MappingTable::getCommandforMessage(const MIDI_Message_ID& message) const {
+  const auto command_id = Entry_(message).command_id;
+  if (command_id == kNoCommand)
+    throw std::out_of_range("MappingTable::getCommandforMessage");
+  return getCommandString(command_id);
+}
+
+inline const MappedCommand* MappingTable::findCommand(const MIDI_Message_ID& message)
+const noexcept(ndebug) {
+  const auto& entry = Entry_(message);
+  return entry.command_id != kNoCommand ? &entry : nullptr;
+}
+
+inline const MappedCommand* MappingTable::resolveCommand(MIDI_Message_ID& message)
+const noexcept(ndebug) {
+  const auto* entry = findCommand(message);
+  if (entry || message.device == 0)
+    return entry;
+  message.device = 0;
+  return findCommand(message);
+}
+
+inline double MappingTable::lrValue(const MappedCommand& entry, int value,
+  int max_value) const noexcept(ndebug) {
+  if (entry.transform_id == 0)
+    return static_cast<double>(value) / max_value;
+  const auto& table = transforms_[entry.transform_id - 1]->table;
+  if (static_cast<size_t>(max_value) + 1 == table.size())
+    return table[value];
+  // a 7-bit control sent at 14 bits: interpolate
+  const auto position = static_cast<double>(value) * (table.size() - 1) / max_value;
+  const auto index = std::min(static_cast<size_t>(position), table.size() - 2);
+  const auto fraction = position - index;
+  return table[index] + (table[index + 1] - table[index]) * fraction;
+}
+
+inline CC_MODE MappingTable::getCCMode(const MIDI_Message_ID& message) const {
+  return Entry_(message).cc_mode;
+}
+
+inline void MappingTable::setCCMode(const MIDI_Message_ID& message, CC_MODE mode) {
+  auto* entry = EditEntry_(message);
+  if (entry && entry->command_id != kNoCommand)
+    entry->cc_mode = mode;
+}
+
+inline void MappingTable::removeMessage(const MIDI_Message_ID& message) {
   // removes message from the message:command map, and its associated command from
   // the command:message map
-  command_string_map_.erase(message_map_[message]);
-  message_map_.erase(message);
+  auto* entry = EditEntry_(message);
+  if (entry == nullptr || entry->command_id == kNoCommand)
+    return;
+  Unlink_(message, entry->command_id);
+  *entry = kUnmapped;
+}
+
+inline void MappingTable::clearMap() noexcept {
+  for (auto& messages : messages_by_command_)
+    messages.clear();
+  transforms_.clear();
+  macros_.clear();
+  tables_.resize(1);
+  std::fill(tables_.front().begin(), tables_.front().end(), kUnmapped);
+}
+
+inline bool MappingTable::messageExistsInMap(const MIDI_Message_ID& message) const {
+  return Entry_(message).command_id != kNoCommand;
 }
 
-inline void CommandMap::clearMap() noexcept {
-  command_string_map_.clear();
-  message_map_.clear();
+inline gsl::span<const MIDI_Message_ID> MappingTable::getMessagesForCommand(
+  unsigned short command_id) const noexcept {
+  if (command_id >= messages_by_command_.size())
+    return {};
+  const auto& messages = messages_by_command_[command_id];
+  return {messages.data(), messages.size()};
+}
+
+inline gsl::span<const MIDI_Message_ID> MappingTable::getMessagesForCommand(
+  const std::string& command) const {
+  return getMessagesForCommand(FindCommand_(command));
+}
+
+inline gsl::span<const unsigned short> MappingTable::getMacroIds(
+  const MappedCommand& entry) const noexcept {
+  if (entry.macro_id == 0)
+    return {};
+  const auto& macro = macros_[entry.macro_id - 1];
+  return {macro.data(), macro.size()};
+}
+
+inline size_t MappingTable::commandCount() const noexcept {
+  return messages_by_command_.size();
+}
+
+inline bool MappingTable::commandHasAssociatedMessage(const std::string& command) const {
+  return getMessagesForCommand(command).size() != 0;
+}
+
+class BankListener {
+public:
+  // called on the message thread after a bank command has switched banks;
+  // both tables stay valid for the call
+  virtual void bankSelected(const MappingTable& previous, const MappingTable& next) = 0;
+  virtual ~BankListener() {};
+};
+
+class CommandMap final: private juce::AsyncUpdater {
+  // The message thread edits working MappingTables, one per bank, and
+  // publishes a copy of each after it changes. The MIDI and Lightroom threads
+  // read through getSnapshot, which pins the active bank's published copy
+  // without locking, so an edit never blocks or tears a lookup in progress.
+  // Edits are published together once the message thread is next idle, or at
+  // EndBatch, so a burst of edits copies each table once.
+  // Banks are alternative mapping sets within a profile, all resident:
+  // selecting one publishes its copy again, a pointer swap. Edits apply to
+  // the active bank. Only getSnapshot and QueueBankCommand may be called from
+  // threads other than the message thread.
+public:
+  static constexpr unsigned short kNoCommand = MappingTable::kNoCommand;
+  static constexpr size_t kMaxBanks = 8; // one for each "Bank n" command
+
+  // names used for CC_MODE in profiles and menus
+  static const std::vector<std::string> CCModeNames;
+
+  using Snapshot = RSJ::snapshot_ptr<MappingTable>::pin;
+
+  CommandMap();
+  virtual ~CommandMap() {}
+
+  void addBankListener(BankListener* listener);
+
+  // latest published table of the active bank, for use from any thread. hold
+  // it only for the duration of one lookup or dispatch
+  Snapshot getSnapshot() const noexcept;
+
+  // edits between BeginBatch and EndBatch are published once, at EndBatch
+  void BeginBatch();
+  void EndBatch();
+
+  // BeginBatch for its lifetime, so the batch ends even if an edit throws
+  class Batch {
+  public:
+    explicit Batch(CommandMap* map): map_(map) {
+      if (map_)
+        map_->BeginBatch();
+    }
+    ~Batch() {
+      if (map_)
+        map_->EndBatch();
+    }
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+  private:
+    CommandMap* map_;
+  };
+
+  // count is clamped to 1..kMaxBanks
+  size_t getBankCount() const noexcept;
+  void setBankCount(size_t count);
+  // safe from any thread, though the bank may change as soon as it returns
+  size_t getActiveBank() const noexcept;
+  // returns false if the bank doesn't exist or is already active
+  bool SelectBank(size_t bank);
+  // carries out one of LRCommandList::BankSelect on the message thread. safe
+  // from any thread and never waits for an edit in progress; messages read
+  // before the switch is published still use the old bank
+  void QueueBankCommand(unsigned short command_id);
+
+  // small id for a MIDI device's name, for MIDI_Message_ID::device. ids are
+  // kept for the life of the map; an empty name is 0, any device
+  unsigned short InternDevice(const juce::String& device_name);
+  juce::String getDeviceName(unsigned short device) const;
+
+  void addCommandforMessage(unsigned int command, const MIDI_Message_ID& message);
+  void addCommandforMessage(const std::string& command, const MIDI_Message_ID& message);
+  const std::string& getCommandforMessage(const MIDI_Message_ID& message) const;
+  CC_MODE getCCMode(const MIDI_Message_ID& message) const;
+  void setCCMode(const MIDI_Message_ID& message, CC_MODE mode);
+  const ValueTransform& getTransform(const MIDI_Message_ID& message) const;
+  void setTransform(const MIDI_Message_ID& message, const ValueTransform& transform);
+  std::vector<std::string> getMacro(const MIDI_Message_ID& message) const;
+  void setMacro(const MIDI_Message_ID& message, const std::vector<std::string>& commands);
+  void removeMessage(const MIDI_Message_ID& message);
+  // clears every bank and leaves only the first
+  void clearMap();
+  bool messageExistsInMap(const MIDI_Message_ID& message) const;
+  bool commandHasAssociatedMessage(const std::string& command) const;
+  // messages mapped in the active bank
+  std::vector<MIDI_Message_ID> getMessages() const;
+  // saves every bank
+  void toXMLDocument(juce::File& file) const;
+
+private:
+  static constexpr int kNoBank = -1;
+
+  // AsyncUpdater interface, applies queued bank commands and publishes edits
+  virtual void handleAsyncUpdate() override;
+  MappingTable& Working_() noexcept;
+  const MappingTable& Working_() const noexcept;
+  void Changed_();
+  void Publish_();
+
+  std::vector<MappingTable> banks_; // working copies
+  std::vector<std::shared_ptr<const MappingTable>> published_banks_;
+  std::vector<bool> bank_changed_; // not published since edited
+  // owned by the message thread, which changes it only under writer_mutex_;
+  // atomic so getActiveBank may be read from any thread
+  std::atomic<size_t> active_bank_{0};
+  std::vector<juce::String> device_names_{juce::String{}}; // by device id
+  std::vector<BankListener*> bank_listeners_;
+  // bank commands waiting for the message thread: the last absolute bank,
+  // then the previous/next steps taken after it
+  std::atomic<int> requested_bank_{kNoBank};
+  std::atomic<int> requested_steps_{0};
+  bool active_changed_{false};
+  int batch_depth_{0};
+  // the message thread is the only writer; held from BeginBatch to EndBatch
+  mutable std::recursive_mutex writer_mutex_;
+  RSJ::snapshot_ptr<MappingTable> published_;
+};
+
+inline CommandMap::Snapshot CommandMap::getSnapshot() const noexcept {
+  return published_.acquire();
+}
+
+inline size_t CommandMap::getBankCount() const noexcept {
+  return banks_.size();
+}
+
+inline size_t CommandMap::getActiveBank() const noexcept {
+  return active_bank_;
+}
+
+inline MappingTable& CommandMap::Working_() noexcept {
+  return banks_[active_bank_];
+}
+
+inline const MappingTable& CommandMap::Working_() const noexcept {
+  return banks_[active_bank_];
+}
+
+inline const std::string& CommandMap::getCommandforMessage(const MIDI_Message_ID& message) const {
+  return Working_().getCommandforMessage(message);
+}
+
+inline CC_MODE CommandMap::getCCMode(const MIDI_Message_ID& message) const {
+  return Working_().getCCMode(message);
+}
+
+inline const ValueTransform& CommandMap::getTransform(const MIDI_Message_ID& message) const {
+  return Working_().getTransform(message);
+}
+
+inline std::vector<std::string> CommandMap::getMacro(const MIDI_Message_ID& message) const {
+  return Working_().getMacro(message);
 }
 
 inline bool CommandMap::messageExistsInMap(const MIDI_Message_ID& message) const {
-  return message_map_.find(message) != message_map_.end();
+  return Working_().messageExistsInMap(message);
 }
 
 inline bool CommandMap::commandHasAssociatedMessage(const std::string& command) const {
-  return command_string_map_.find(command) != command_string_map_.end();
+  return Working_().commandHasAssociatedMessage(command);
+}
+
+inline std::vector<MIDI_Message_ID> CommandMap::getMessages() const {
+  return Working_().getMappedMessages();
 }
 #endif  // COMMANDMAP_H_INCLUDED
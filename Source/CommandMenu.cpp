@@ -23,6 +23,26 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <limits>
 #include "LRCommands.h"
 
+namespace {
+  // menu ids above the command indices
+  constexpr size_t kCCModeItem = 10000;
+  constexpr size_t kCurveItem = 10100;
+  constexpr size_t kInvertItem = 10200;
+  constexpr size_t kRangeItem = 10201;
+  constexpr size_t kClearMacroItem = 10300;
+  constexpr size_t kMacroItem = 20000; // plus the command index
+
+  // command indices run through LRStringList, NextPrevProfile, then BankSelect
+  const std::string& CommandName(size_t index) {
+    if (index < LRCommandList::LRStringList.size())
+      return LRCommandList::LRStringList[index];
+    index -= LRCommandList::LRStringList.size();
+    if (index < LRCommandList::NextPrevProfile.size())
+      return LRCommandList::NextPrevProfile[index];
+    return LRCommandList::BankSelect.at(index - LRCommandList::NextPrevProfile.size());
+  }
+}
+
 CommandMenu::CommandMenu(const MIDI_Message_ID& message):
   juce::TextButton{"Unmapped"},
   message_{message},
@@ -31,7 +51,7 @@ CommandMenu::CommandMenu(const MIDI_Message_ID& message):
   "Basic", "Tone Curve", "HSL / Color / B&W", "Reset HSL / Color / B&W",
   "Split Toning", "Detail", "Lens Corrections", "Effects", "Camera Calibration",
   "Develop Presets", "Local Adjustments", "Crop", "Go to Tool, Module, or Panel",
-  "Secondary Display", "Profiles", "Next/Prev Profile"}),
+  "Secondary Display", "Profiles", "Next/Prev Profile", "Mapping Banks"}),
 
   menu_entries_({LRCommandList::KeyShortcuts, LRCommandList::General,
   LRCommandList::Library, LRCommandList::Develop,
@@ -41,7 +61,8 @@ CommandMenu::CommandMenu(const MIDI_Message_ID& message):
   LRCommandList::Calibration, LRCommandList::DevelopPresets,
   LRCommandList::LocalAdjustments, LRCommandList::Crop,
   LRCommandList::ToolModulePanel, LRCommandList::SecondaryDisplay,
-  LRCommandList::ProgramProfiles, LRCommandList::NextPrevProfile})
+  LRCommandList::ProgramProfiles, LRCommandList::NextPrevProfile,
+  LRCommandList::BankSelect})
 {}
 
 void CommandMenu::Init(std::shared_ptr<CommandMap>& mapCommand) {
@@ -56,10 +77,18 @@ void CommandMenu::setMsg(const MIDI_Message_ID& message) noexcept {
 
 void CommandMenu::setSelectedItem(unsigned int index) {
   selected_item_ = index;
-  if (index - 1 < LRCommandList::LRStringList.size())
-    setButtonText(LRCommandList::LRStringList[index - 1]);
-  else
-    setButtonText(LRCommandList::NextPrevProfile[index - 1 - LRCommandList::LRStringList.size()]);
+  UpdateText_();
+}
+
+void CommandMenu::UpdateText_() {
+  // macros show how many commands follow the first
+  auto text = juce::String{CommandName(selected_item_ - 1)};
+  if (command_map_) {
+    const auto macro_size = command_map_->getMacro(message_).size();
+    if (macro_size > 0)
+      text << " +" << static_cast<int>(macro_size);
+  }
+  setButtonText(text);
 }
 
 void CommandMenu::buttonClicked(juce::Button* /*button*/) {
@@ -97,21 +126,112 @@ void CommandMenu::buttonClicked(juce::Button* /*button*/) {
     submenu_tick_set |= (selected_item_ < index && !submenu_tick_set);
   }
 
+  // 7-bit CCs may come from endless encoders
+  if (message_.isCC() && message_.controller < 128 && command_map_) {
+    juce::PopupMenu mode_menu;
+    const auto current_mode = static_cast<size_t>(command_map_->getCCMode(message_));
+    for (size_t mode = 0; mode < CommandMap::CCModeNames.size(); ++mode)
+      mode_menu.addItem(kCCModeItem + mode, CommandMap::CCModeNames[mode], true,
+        mode == current_mode);
+    main_menu.addSeparator();
+    main_menu.addSubMenu("CC Mode", mode_menu);
+  }
+
+  // notes are buttons, anything else carries a value to transform
+  if (message_.msg_type != MIDI_MSG_TYPE::NOTE && command_map_) {
+    juce::PopupMenu response_menu;
+    const auto& transform = command_map_->getTransform(message_);
+    for (size_t curve = 0; curve < MappingTable::CurveNames.size(); ++curve)
+      response_menu.addItem(kCurveItem + curve, MappingTable::CurveNames[curve], true,
+        curve == static_cast<size_t>(transform.curve));
+    response_menu.addSeparator();
+    response_menu.addItem(kInvertItem, "Invert", true, transform.invert);
+    response_menu.addItem(kRangeItem, "Range...");
+    main_menu.addSubMenu("Response", response_menu);
+  }
+
+  // Lightroom commands may be followed by more, sent with them
+  if (selected_item_ > 1 && selected_item_ - 1 < LRCommandList::LRStringList.size() &&
+    command_map_) {
+    juce::PopupMenu macro_menu;
+    size_t command_index = 1;
+    for (size_t menu_index = 0; menu_index < menus_.size(); ++menu_index) {
+      if (command_index >= LRCommandList::LRStringList.size())
+        break;
+      juce::PopupMenu step_menu;
+      for (const auto& command : menu_entries_[menu_index])
+        step_menu.addItem(kMacroItem + command_index++, command);
+      macro_menu.addSubMenu(menus_[menu_index], step_menu);
+    }
+    const auto macro = command_map_->getMacro(message_);
+    macro_menu.addSeparator();
+    for (const auto& command : macro)
+      macro_menu.addItem(-1, "then " + command, false);
+    macro_menu.addItem(kClearMacroItem, "Clear", !macro.empty());
+    main_menu.addSubMenu("Then Send", macro_menu);
+  }
+
   const auto result = static_cast<size_t>(main_menu.show());
-  if ((result) && (command_map_)) {
+  if ((result >= kMacroItem) && (command_map_)) {
+    auto macro = command_map_->getMacro(message_);
+    macro.push_back(LRCommandList::LRStringList[result - kMacroItem]);
+    command_map_->setMacro(message_, macro);
+    UpdateText_();
+  }
+  else if ((result == kClearMacroItem) && (command_map_)) {
+    command_map_->setMacro(message_, {});
+    UpdateText_();
+  }
+  else if ((result == kRangeItem) && (command_map_)) {
+    EditRange_();
+  }
+  else if ((result == kInvertItem) && (command_map_)) {
+    auto transform = command_map_->getTransform(message_);
+    transform.invert = !transform.invert;
+    command_map_->setTransform(message_, transform);
+  }
+  else if ((result >= kCurveItem) && (command_map_)) {
+    auto transform = command_map_->getTransform(message_);
+    transform.curve = static_cast<RESPONSE_CURVE>(result - kCurveItem);
+    command_map_->setTransform(message_, transform);
+  }
+  else if ((result >= kCCModeItem) && (command_map_)) {
+    command_map_->setCCMode(message_, static_cast<CC_MODE>(result - kCCModeItem));
+  }
+  else if ((result) && (command_map_)) {
       // user chose a different command, remove previous command mapping
-      // associated to this menu
+      // associated to this menu, keeping its CC mode, transform and macro
+    CommandMap::Batch batch{command_map_.get()};
+    const auto cc_mode = command_map_->getCCMode(message_);
+    const auto transform = command_map_->getTransform(message_);
+    const auto macro = command_map_->getMacro(message_);
     if (selected_item_ < std::numeric_limits<unsigned int>::max())
       command_map_->removeMessage(message_);
 
-    if (result - 1 < LRCommandList::LRStringList.size())
-      setButtonText(LRCommandList::LRStringList[result - 1]);
-    else
-      setButtonText(LRCommandList::NextPrevProfile[result - 1 - LRCommandList::LRStringList.size()]);
-
     selected_item_ = result;
 
     // Map the selected command to the CC
     command_map_->addCommandforMessage(result - 1, message_);
+    command_map_->setCCMode(message_, cc_mode);
+    command_map_->setTransform(message_, transform);
+    command_map_->setMacro(message_, macro);
+    UpdateText_();
   }
+}
+
+void CommandMenu::EditRange_() {
+  auto transform = command_map_->getTransform(message_);
+  juce::AlertWindow window{"Range", "Percent of the parameter's range sent at "
+    "the bottom and top of the control's travel.", juce::AlertWindow::NoIcon};
+  window.addTextEditor("min", juce::String{transform.min * 100.0}, "Bottom");
+  window.addTextEditor("max", juce::String{transform.max * 100.0}, "Top");
+  window.addButton("OK", 1, juce::KeyPress{juce::KeyPress::returnKey});
+  window.addButton("Cancel", 0, juce::KeyPress{juce::KeyPress::escapeKey});
+  if (window.runModalLoop() != 1)
+    return;
+  transform.min = juce::jlimit(0.0, 1.0,
+    window.getTextEditorContents("min").getDoubleValue() / 100.0);
+  transform.max = juce::jlimit(0.0, 1.0,
+    window.getTextEditorContents("max").getDoubleValue() / 100.0);
+  command_map_->setTransform(message_, transform);
 }
\ No newline at end of file
@@ -42,6 +42,10 @@ class CommandMenu final: public juce::TextButton,
 private:
   // ButtonListener interface
   virtual void buttonClicked(juce::Button* button) override;
+  // asks for the min and max of the message's transform
+  void EditRange_();
+  // shows the selected command and the length of its macro
+  void UpdateText_();
 
   const std::vector<juce::String> menus_;
   const std::vector<std::vector<std::string>> menu_entries_;
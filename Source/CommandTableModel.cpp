@@ -78,12 +78,29 @@ void CommandTableModel::paintCell(juce::Graphics& g, int row_number, int column_
 
   if (column_id == 1) // write the MIDI message in the MIDI command column
   {
-    if (commands_[row_number].isCC)
-      g.drawText(juce::String::formatted("%d | CC: %d", commands_[row_number].channel,
-        commands_[row_number].controller), 0, 0, width, height, juce::Justification::centred);
-    else
-      g.drawText(String::formatted("%d | Note: %d", commands_[row_number].channel,
-        commands_[row_number].pitch), 0, 0, width, height, Justification::centred);
+    const auto& message = commands_[row_number];
+    juce::String text;
+    switch (message.msg_type) {
+      case MIDI_MSG_TYPE::NOTE:
+        text = juce::String::formatted("%d | Note: %d", message.channel, message.pitch);
+        break;
+      case MIDI_MSG_TYPE::CC:
+        text = juce::String::formatted("%d | CC: %d", message.channel, message.controller);
+        break;
+      case MIDI_MSG_TYPE::PITCHBEND:
+        text = juce::String::formatted("%d | Pitch Bend", message.channel);
+        break;
+      case MIDI_MSG_TYPE::CHANNEL_PRESSURE:
+        text = juce::String::formatted("%d | Channel Pressure", message.channel);
+        break;
+      case MIDI_MSG_TYPE::KEY_PRESSURE:
+        text = juce::String::formatted("%d | Key Pressure: %d", message.channel,
+          message.pitch);
+        break;
+    }
+    if (message.device != 0 && command_map_)
+      text = command_map_->getDeviceName(message.device) + ": " + text;
+    g.drawText(text, 0, 0, width, height, juce::Justification::centred);
   }
 }
 
@@ -137,8 +154,7 @@ juce::Component *CommandTableModel::refreshComponentForCell(int row_number,
     return nullptr;
 }
 
-void CommandTableModel::addRow(int midi_channel, int midi_data, bool is_cc) {
-  const MIDI_Message_ID msg{midi_channel, midi_data, is_cc};
+void CommandTableModel::addRow(const MIDI_Message_ID& msg) {
   if (command_map_ && !command_map_->messageExistsInMap(msg)) {
     commands_.push_back(msg);
     command_map_->addCommandforMessage(0, msg); // add an entry for 'no command'
@@ -165,14 +181,39 @@ void CommandTableModel::buildFromXml(const juce::XmlElement * const root) {
   if (root->getTagName().compare("settings") != 0)
     return;
 
+  // publish the whole profile to the MIDI threads at once
+  CommandMap::Batch batch{command_map_.get()};
   removeAllRows();
 
   auto* setting = root->getFirstChildElement();
   while ((setting) && (command_map_)) {
-    if (setting->hasAttribute("controller")) {
-      const MIDI_Message_ID message{setting->getIntAttribute("channel"),
-        setting->getIntAttribute("controller"), true};
-      addRow(message.channel, message.controller, true);
+    const auto channel = setting->getIntAttribute("channel");
+    MIDI_Message_ID message;
+    auto recognized = true;
+    if (setting->hasAttribute("controller"))
+      message = {channel, setting->getIntAttribute("controller"), MIDI_MSG_TYPE::CC};
+    else if (setting->hasAttribute("note"))
+      message = {channel, setting->getIntAttribute("note"), MIDI_MSG_TYPE::NOTE};
+    else if (setting->hasAttribute("pitchbend"))
+      message = {channel, 0, MIDI_MSG_TYPE::PITCHBEND};
+    else if (setting->hasAttribute("channel_pressure"))
+      message = {channel, 0, MIDI_MSG_TYPE::CHANNEL_PRESSURE};
+    else if (setting->hasAttribute("key_pressure"))
+      message = {channel, setting->getIntAttribute("key_pressure"),
+      MIDI_MSG_TYPE::KEY_PRESSURE};
+    else
+      recognized = false;
+
+    if (recognized) {
+      // a mapping for one device only names the device
+      message.device = command_map_->InternDevice(setting->getStringAttribute("device"));
+      // only the first bank is shown until another is selected
+      const auto bank = static_cast<size_t>(std::max(setting->getIntAttribute("bank"), 0));
+      if (bank >= command_map_->getBankCount())
+        command_map_->setBankCount(bank + 1);
+      command_map_->SelectBank(bank);
+      if (bank == 0)
+        addRow(message);
 
       // older versions of MIDI2LR stored the index of the string, so we should attempt to parse this as well
       if (setting->getIntAttribute("command", -1) != -1) {
@@ -183,31 +224,48 @@ void CommandTableModel::buildFromXml(const juce::XmlElement * const root) {
         command_map_->addCommandforMessage(setting->
           getStringAttribute("command_string").toStdString(), message);
       }
-    }
-    else if (setting->hasAttribute("note")) {
-      const MIDI_Message_ID note{setting->getIntAttribute("channel"),
-        setting->getIntAttribute("note"), false};
-      addRow(note.channel, note.pitch, false);
-
-      // older versions of MIDI2LR stored the index of the string, so we should attempt to parse this as well
-      if (setting->getIntAttribute("command", -1) != -1) {
-        command_map_->addCommandforMessage(setting->getIntAttribute("command"),
-          note);
-      }
-      else {
-        command_map_->addCommandforMessage(setting->
-          getStringAttribute("command_string").toStdString(), note);
-      }
+      const auto cc_mode = std::find(CommandMap::CCModeNames.begin(),
+        CommandMap::CCModeNames.end(),
+        setting->getStringAttribute("cc_mode").toStdString());
+      if (cc_mode != CommandMap::CCModeNames.end())
+        command_map_->setCCMode(message, static_cast<CC_MODE>(cc_mode -
+          CommandMap::CCModeNames.begin()));
+      ValueTransform transform;
+      transform.min = setting->getDoubleAttribute("min", 0.0);
+      transform.max = setting->getDoubleAttribute("max", 1.0);
+      transform.invert = setting->getBoolAttribute("invert");
+      const auto curve = std::find(MappingTable::CurveNames.begin(),
+        MappingTable::CurveNames.end(),
+        setting->getStringAttribute("curve").toStdString());
+      if (curve != MappingTable::CurveNames.end())
+        transform.curve = static_cast<RESPONSE_CURVE>(curve -
+          MappingTable::CurveNames.begin());
+      command_map_->setTransform(message, transform);
+      // a macro's further commands are child elements, in order
+      std::vector<std::string> macro;
+      forEachXmlChildElementWithTagName(*setting, step, "command")
+        macro.push_back(step->getStringAttribute("command_string").toStdString());
+      if (!macro.empty())
+        command_map_->setMacro(message, macro);
     }
     setting = setting->getNextElement();
   }
+  // the rows are bank 0's, so sort by its commands
+  if (command_map_)
+    command_map_->SelectBank(0);
+  Sort();
+}
+
+void CommandTableModel::buildFromMap() {
+  commands_.clear();
+  if (command_map_)
+    commands_ = command_map_->getMessages();
   Sort();
 }
 
-int CommandTableModel::getRowForMessage(int midi_channel, int midi_data, bool is_cc) const {
+int CommandTableModel::getRowForMessage(const MIDI_Message_ID& message) const {
   for (size_t idx = 0u; idx < commands_.size(); idx++) {
-    if (commands_[idx].channel == midi_channel && commands_[idx].controller == midi_data
-      && commands_[idx].isCC == is_cc)
+    if (commands_[idx] == message)
       return idx;
   }
   //could not find
@@ -217,8 +275,11 @@ int CommandTableModel::getRowForMessage(int midi_channel, int midi_data, bool is
 void CommandTableModel::Sort() {
   // use LRCommandList::getIndexOfCommand(string); to sort by command
   // sort the command map
-  auto msg_idx = [this](MIDI_Message_ID a) {return LRCommandList::getIndexOfCommand
-  (command_map_->getCommandforMessage(a)); };
+  // unmapped messages sort first
+  auto msg_idx = [this](MIDI_Message_ID a) {
+    return command_map_->messageExistsInMap(a) ?
+      LRCommandList::getIndexOfCommand(command_map_->getCommandforMessage(a)) : -1;
+  };
 
   if (current_sort.first == 1)
     if (current_sort.second)
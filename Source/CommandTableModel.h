@@ -45,7 +45,7 @@ class CommandTableModel final: public juce::TableListBoxModel {
     bool isRowSelected, juce::Component *existingComponentToUpdate) override;
 
   // adds a row with a corresponding MIDI message to the table
-  void addRow(int midi_channel, int midi_data, bool isCC);
+  void addRow(const MIDI_Message_ID& message);
 
   // removes a row from the table
   void removeRow(int row);
@@ -56,8 +56,11 @@ class CommandTableModel final: public juce::TableListBoxModel {
   // builds the table from an XML file
   void buildFromXml(const juce::XmlElement * const elem);
 
+  // rebuilds the rows from the command map's active bank
+  void buildFromMap();
+
   // returns the index of the row associated to a particular MIDI message
-  int getRowForMessage(int midi_channel, int midi_data, bool isCC) const;
+  int getRowForMessage(const MIDI_Message_ID& message) const;
 
 private:
   void Sort();
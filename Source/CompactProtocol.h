@@ -0,0 +1,76 @@
+#pragma once
+/*
+  ==============================================================================
+
+    CompactProtocol.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef COMPACTPROTOCOL_H_INCLUDED
+#define COMPACTPROTOCOL_H_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Compact lines carry parameter values between the app and the plugin as
+// "~" followed by six characters per value, then a newline: a 16-bit
+// command id (the index in LRCommandList::LRStringList) and a 16-bit value,
+// each written as three 6-bit digits from '0'. They stay printable and
+// newline free, as the plugin's sockets work in lines.
+//
+// Text lines are always understood. The plugin sends "Protocol 2" when the
+// app connects to it; the app then sends "CommandIds <first id> <name>..."
+// lines naming the ids, and "Protocol 2" to say values may follow as
+// compact lines. The plugin replies in compact lines once it has the ids.
+namespace CompactProtocol {
+  constexpr int kVersion = 2; // text lines alone are version 1
+  constexpr char kMarker = '~'; // first character of a compact line
+  constexpr size_t kUpdateSize = 6; // characters per id and value
+  constexpr size_t kMaxUpdates = 32; // per line, within LR_IPC_IN's line buffer
+  constexpr char kDigitBase = '0';
+  constexpr double kValueScale = 65535.0;
+
+  // writes kUpdateSize characters for command_id and value (0.0-1.0, clamped)
+  inline char* Encode(size_t command_id, double value, char* out) noexcept {
+    const auto scaled = static_cast<unsigned int>(std::lround(
+      std::min(std::max(value, 0.0), 1.0) * kValueScale));
+    const auto id = static_cast<unsigned int>(command_id & 0xFFFFu);
+    out[0] = static_cast<char>(kDigitBase + (id >> 12));
+    out[1] = static_cast<char>(kDigitBase + ((id >> 6) & 0x3F));
+    out[2] = static_cast<char>(kDigitBase + (id & 0x3F));
+    out[3] = static_cast<char>(kDigitBase + (scaled >> 12));
+    out[4] = static_cast<char>(kDigitBase + ((scaled >> 6) & 0x3F));
+    out[5] = static_cast<char>(kDigitBase + (scaled & 0x3F));
+    return out + kUpdateSize;
+  }
+
+  // reads kUpdateSize characters, false if they aren't compact digits
+  inline bool Decode(const char* in, size_t& command_id, double& value) noexcept {
+    unsigned int digits[kUpdateSize];
+    for (size_t index = 0; index < kUpdateSize; ++index) {
+      digits[index] = static_cast<unsigned int>(in[index] - kDigitBase);
+      if (digits[index] > 0x3Fu)
+        return false;
+    }
+    command_id = (digits[0] << 12) | (digits[1] << 6) | digits[2];
+    const auto scaled = (digits[3] << 12) | (digits[4] << 6) | digits[5];
+    value = std::min(scaled / kValueScale, 1.0);
+    return true;
+  }
+}
+
+#endif  // COMPACTPROTOCOL_H_INCLUDED
@@ -0,0 +1,254 @@
+/*
+  ==============================================================================
+
+    IOReactor.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "IOReactor.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {
+  constexpr int kConnectTryTime = 100;
+  constexpr auto kHost = "127.0.0.1";
+  constexpr int kLrOutPort = 58763; // the plugin receives on this one
+  constexpr int kLrInPort = 58764;
+  constexpr size_t kSendChannel = 0;
+  constexpr size_t kReceiveChannel = 1;
+  constexpr int kFirstRetryDelay = 50;
+  // poll timeout while a write waits without a wake socket to end the poll
+  constexpr int kWriteWaitFallback = 5;
+  constexpr int kMaxRetryDelay = 1000;
+  // longest wait, so a stop request is seen
+  constexpr int kPollTimeout = 250;
+  constexpr int kStopWait = 1000;
+
+  int Poll(pollfd* fds, size_t count, int timeout) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeout);
+#else
+    return poll(fds, static_cast<nfds_t>(count), timeout);
+#endif
+  }
+}
+
+IOReactor::IOReactor(): juce::Thread{"IOReactor"} {
+  channels_[kSendChannel].port = kLrOutPort;
+  channels_[kReceiveChannel].port = kLrInPort;
+  for (auto& channel : channels_) {
+    channel.retry_delay = 0;
+    channel.next_attempt = 0;
+  }
+  if (wake_socket_.bindToPort(0, kHost))
+    wake_port_ = wake_socket_.getBoundPort();
+}
+
+IOReactor::~IOReactor() {
+  Stop();
+}
+
+void IOReactor::Init(IOReceiver* receiver) {
+  receiver_ = receiver;
+}
+
+void IOReactor::Start() {
+  juce::Thread::startThread();
+}
+
+void IOReactor::PleaseStopThread() {
+  juce::Thread::signalThreadShouldExit();
+  juce::Thread::notify();
+  Wake_();
+}
+
+void IOReactor::Stop() {
+  juce::Thread::stopThread(kStopWait);
+  for (auto& channel : channels_)
+    channel.socket.Close();
+}
+
+void IOReactor::addListener(LRConnectionListener* listener) {
+  for (const auto current_listener : listeners_)
+    if (current_listener == listener)
+      return; //don't add duplicates
+  listeners_.push_back(listener);
+}
+
+void IOReactor::NotifyCongestion(bool congested) {
+  for (const auto& listener : listeners_)
+    listener->congestionChanged(congested);
+}
+
+unsigned int IOReactor::SendConnection() const {
+  return channels_[kSendChannel].socket.Connection();
+}
+
+unsigned int IOReactor::ReceiveConnection() const {
+  return channels_[kReceiveChannel].socket.Connection();
+}
+
+int IOReactor::Write(const char* data, size_t length, unsigned int connection) {
+  return channels_[kSendChannel].socket.Write(data, length, connection);
+}
+
+void IOReactor::WaitWritable() {
+  if (!want_write_.exchange(true))
+    Wake_(); // poll again with the send socket's room included
+}
+
+void IOReactor::Wake_() {
+  if (wake_port_ > 0) {
+    const char byte = 0;
+    wake_sender_.write(kHost, wake_port_, &byte, 1);
+  }
+}
+
+void IOReactor::run() {
+  while (!juce::Thread::threadShouldExit()) {
+    const auto now = juce::Time::getMillisecondCounter();
+    auto timeout = kPollTimeout;
+    pollfd fds[3];
+    Channel* polled[3]; // nullptr for the wake socket
+    size_t count = 0;
+    for (auto& channel : channels_) {
+      if (!channel.socket.IsConnected()) {
+        if (static_cast<int>(channel.next_attempt - now) <= 0)
+          Connect_(channel, now);
+        if (!channel.socket.IsConnected()) {
+          timeout = std::min(timeout,
+            std::max(static_cast<int>(channel.next_attempt - now), 0));
+          continue;
+        }
+      }
+      fds[count].fd = static_cast<decltype(fds[count].fd)>(channel.socket.GetHandle());
+      fds[count].events = POLLIN;
+      if (&channel == &channels_[kSendChannel] && want_write_.load())
+        fds[count].events |= POLLOUT;
+      fds[count].revents = 0;
+      polled[count++] = &channel;
+    }
+    UpdateConnected_();
+    if (count == 0) {
+      juce::Thread::wait(timeout);
+      continue;
+    }
+    if (wake_port_ > 0) {
+      fds[count].fd = static_cast<decltype(fds[count].fd)>(wake_socket_.getRawSocketHandle());
+      fds[count].events = POLLIN;
+      fds[count].revents = 0;
+      polled[count++] = nullptr;
+    }
+    else if (want_write_.load())
+      timeout = std::min(timeout, kWriteWaitFallback);
+    const auto ready = Poll(fds, count, timeout);
+    if (ready < 0) // interrupted, or worse: don't spin on it
+      juce::Thread::wait(kFirstRetryDelay);
+    if (ready <= 0)
+      continue;
+    for (size_t index = 0; index < count; ++index) {
+      const auto revents = fds[index].revents;
+      if (!revents)
+        continue;
+      if (!polled[index]) { // woken: the datagrams only ended the poll
+        char discard[16];
+        while (wake_socket_.read(discard, sizeof(discard), false) > 0) {}
+        continue;
+      }
+      if (revents & POLLOUT) {
+        want_write_ = false;
+        writable_ = true;
+        juce::AsyncUpdater::triggerAsyncUpdate();
+      }
+      // a closed connection reads as such, whatever else is reported
+      if ((revents & ~POLLOUT) && (!Read_(*polled[index]) || (revents & POLLNVAL)))
+        Lose_(*polled[index]);
+    }
+  }
+}
+
+void IOReactor::Connect_(Channel& channel, juce::uint32 now) {
+  if (channel.socket.Connect(kHost, channel.port, kConnectTryTime)) {
+    channel.retry_delay = 0;
+    if (&channel == &channels_[kReceiveChannel] && receiver_)
+      receiver_->receiverReset();
+    return;
+  }
+  channel.retry_delay = channel.retry_delay ?
+    std::min(channel.retry_delay * 2, kMaxRetryDelay) : kFirstRetryDelay;
+  channel.next_attempt = now + static_cast<juce::uint32>(channel.retry_delay);
+}
+
+void IOReactor::Lose_(Channel& channel) {
+  channel.socket.Close();
+  if (&channel == &channels_[kSendChannel])
+    want_write_ = false; // the batch waiting for room is dropped
+  channel.retry_delay = 0; // the plugin may only be restarting: try at once
+  channel.next_attempt = juce::Time::getMillisecondCounter();
+  if (&channel == &channels_[kReceiveChannel] && receiver_)
+    receiver_->receiverReset();
+  UpdateConnected_();
+}
+
+bool IOReactor::Read_(Channel& channel) {
+  // the plugin never writes to the send channel; reading it finds its close
+  const auto receive = &channel == &channels_[kReceiveChannel] && receiver_;
+  for (;;) {
+    const auto received = channel.socket.Read(buffer_, sizeof(buffer_));
+    if (received < 0)
+      return false;
+    if (received == 0)
+      return true;
+    if (receive)
+      receiver_->bytesReceived(buffer_, static_cast<size_t>(received));
+  }
+}
+
+void IOReactor::UpdateConnected_() {
+  const auto connected = channels_[kSendChannel].socket.IsConnected() &&
+    channels_[kReceiveChannel].socket.IsConnected();
+  if (connected == connected_.load(std::memory_order_relaxed))
+    return;
+  if (connected)
+    ++connection_;
+  connected_.store(connected);
+  juce::AsyncUpdater::triggerAsyncUpdate();
+}
+
+void IOReactor::handleAsyncUpdate() {
+  // a connection lost and made again before this runs is still reported as
+  // both, so listeners start afresh
+  const auto connected = connected_.load();
+  const auto connection = connection_.load();
+  if (notified_connected_ && (!connected || connection != notified_connection_)) {
+    notified_connected_ = false;
+    for (const auto& listener : listeners_)
+      listener->disconnected();
+  }
+  if (connected && !notified_connected_) {
+    notified_connected_ = true;
+    notified_connection_ = connection;
+    for (const auto& listener : listeners_)
+      listener->connected();
+  }
+  if (writable_.exchange(false))
+    for (const auto& listener : listeners_)
+      listener->writable();
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+/*
+  ==============================================================================
+
+    IOReactor.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef IOREACTOR_H_INCLUDED
+#define IOREACTOR_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SocketClient.h"
+
+class LRConnectionListener {
+public:
+    // sent when a connection to the LR plugin is made
+  virtual void connected() = 0;
+
+  // sent if disconnected from the LR plugin
+  virtual void disconnected() = 0;
+
+  // sent when writes to the LR plugin start or stop waiting for the socket
+  virtual void congestionChanged(bool /*congested*/) {};
+
+  // sent when the socket takes bytes again, after IOReactor::WaitWritable
+  virtual void writable() {};
+
+  virtual ~LRConnectionListener() {};
+///< .
+};
+
+class IOReceiver {
+public:
+  // bytes the plugin sent, on the reactor thread
+  virtual void bytesReceived(const char* data, size_t size) = 0;
+  // the plugin's connection was made or lost, on the reactor thread
+  virtual void receiverReset() = 0;
+
+  virtual ~IOReceiver() {};
+};
+
+class IOReactor final:
+  private juce::Thread,
+  private juce::AsyncUpdater {
+  // One thread for both sockets to the plugin: it connects them, waits on
+  // both at once, passes what the plugin sends to the receiver and sees a
+  // closed connection as soon as it happens. A lost connection is retried at
+  // once, then with a doubling delay. The plugin counts as connected while
+  // both sockets are; listeners hear of it on the message thread, here only.
+  // A writer that finds the send socket full asks to be told when it has
+  // room (WaitWritable); the thread is woken from poll by a datagram to a
+  // loopback socket of its own.
+  // Connecting is not asynchronous: while the plugin isn't listening, each
+  // attempt can hold the thread for up to kConnectTryTime (100 ms) per
+  // channel, and the other channel isn't read meanwhile. Both sockets are
+  // down or coming up then, so nothing is waiting to be read.
+public:
+  IOReactor();
+  virtual ~IOReactor();
+  void Init(IOReceiver* receiver);
+  void Start();
+  // signal exit to thread
+  void PleaseStopThread();
+  // stops the thread and closes both sockets
+  void Stop();
+
+  // on the message thread; listeners are told in the order they were added
+  void addListener(LRConnectionListener* listener);
+  // tells listeners, on the message thread
+  void NotifyCongestion(bool congested);
+
+  // the connection a batch is written to, 0 if not connected
+  unsigned int SendConnection() const;
+  // the connection the plugin's lines come in on, 0 if not connected
+  unsigned int ReceiveConnection() const;
+  // see SocketClient::Write, safe to call from any thread
+  int Write(const char* data, size_t length, unsigned int connection);
+  // listeners are sent writable() once the send socket has room; on the
+  // message thread
+  void WaitWritable();
+
+private:
+  struct Channel {
+    SocketClient socket;
+    int port;
+    int retry_delay; // milliseconds, 0 to retry at once
+    juce::uint32 next_attempt; // juce::Time::getMillisecondCounter
+  };
+
+  // Thread interface
+  virtual void run() override;
+  // AsyncUpdater interface
+  virtual void handleAsyncUpdate() override;
+
+  void Connect_(Channel& channel, juce::uint32 now);
+  void Lose_(Channel& channel);
+  // drains what the plugin sent on channel; false if it is closed
+  bool Read_(Channel& channel);
+  void UpdateConnected_();
+  // makes the thread's poll return, on the message thread
+  void Wake_();
+
+  Channel channels_[2];
+  IOReceiver* receiver_{nullptr};
+  std::vector<LRConnectionListener*> listeners_;
+  std::atomic<bool> connected_{false};
+  std::atomic<unsigned int> connection_{0}; // counts connections made
+  std::atomic<bool> want_write_{false}; // poll the send socket for room
+  std::atomic<bool> writable_{false}; // room found, listeners not yet told
+  juce::DatagramSocket wake_socket_; // polled with the sockets
+  juce::DatagramSocket wake_sender_; // message thread only
+  int wake_port_{-1}; // wake_socket_'s, -1 if it couldn't be bound
+  bool notified_connected_{false}; // message thread only
+  unsigned int notified_connection_{0}; // message thread only
+  char buffer_[4096];
+};
+
+#endif  // IOREACTOR_H_INCLUDED
@@ -1031,18 +1031,35 @@ const std::vector <std::string> LRCommandList::NextPrevProfile = {
   "Next Profile",
 };
 
-int LRCommandList::getIndexOfCommand(const std::string& command) {
-  static std::unordered_map<std::string, int> indexMap;
+const std::vector <std::string> LRCommandList::BankSelect = {
+  "Previous Bank",
+  "Next Bank",
+  "Bank 1",
+  "Bank 2",
+  "Bank 3",
+  "Bank 4",
+  "Bank 5",
+  "Bank 6",
+  "Bank 7",
+  "Bank 8",
+};
 
-  // better to check for empty then length, as empty has a constant run time behavior.
-  if (indexMap.empty()) {
+int LRCommandList::getIndexOfCommand(const std::string& command) {
+  // built once and only read afterwards, so any thread may look up
+  static const auto index_map = [] {
+    std::unordered_map<std::string, int> map;
     int idx = 0;
     for (const auto& str : LRStringList)
-      indexMap[str] = idx++;
+      map[str] = idx++;
 
     for (const auto& str : NextPrevProfile)
-      indexMap[str] = idx++;
-  }
+      map[str] = idx++;
+
+    for (const auto& str : BankSelect)
+      map[str] = idx++;
+    return map;
+  }();
 
-  return indexMap[command];
+  const auto found = index_map.find(command);
+  return found != index_map.end() ? found->second : 0;
 }
\ No newline at end of file
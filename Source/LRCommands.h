@@ -54,6 +54,7 @@ class LRCommandList {
 
   // MIDI2LR commands
   static const std::vector<std::string> NextPrevProfile;
+  static const std::vector<std::string> BankSelect;
 
   // Map of command strings to indices
   static int getIndexOfCommand(const std::string& command);
@@ -83,13 +83,13 @@ LrTasks.startAsyncTask(
     local LrStringUtils       = import 'LrStringUtils'
     local LrUndo              = import 'LrUndo'
     --global variables
-    MIDI2LR = {PARAM_OBSERVER = {}, SERVER = {}, RUNNING = true} --non-local but in MIDI2LR namespace
+    MIDI2LR = {PARAM_OBSERVER = {}, SERVER = {}, RUNNING = true, COMMAND_IDS = {}, COMPACT = false} --non-local but in MIDI2LR namespace
     --local variables
     local LastParam           = ''
-    local UpdateParamPickup, UpdateParamNoPickup, UpdateParam
+    local CommandNames        = {} -- by id, as named by the app for compact lines
     --local constants--may edit these to change program behaviors
     local BUTTON_ON        = 0.99 -- sending 1.0, but use > BUTTON_ON in case of rounding error
-    local PICKUP_THRESHOLD = 0.03 -- roughly equivalent to 4/127
+    local PROTOCOL         = 2 -- compact lines, see CompactProtocol.h in the app
     local RECEIVE_PORT     = 58763
     local SEND_PORT        = 58764
 
@@ -323,13 +323,22 @@ LrTasks.startAsyncTask(
       ChangedToDirectory = function(value) Profiles.setDirectory(value) end,
       ChangedToFile      = function(value) Profiles.setFile(value) end,
       ChangedToFullPath  = function(value) Profiles.setFullPath(value) end,
-      Pickup             = function(enabled) 
-        if tonumber(enabled) == 1 then -- state machine
-          UpdateParam = UpdateParamPickup
-        else
-          UpdateParam = UpdateParamNoPickup
+      Pickup             = function() end, -- pickup is done by the app
+      CommandIds         = function(value) -- first id, then a name for each id
+        local id
+        for word in value:gmatch('%S+') do
+          if id == nil then
+            id = tonumber(word)
+          else
+            CommandNames[id] = word
+            MIDI2LR.COMMAND_IDS[word] = id
+            id = id + 1
+          end
         end
-      end, 
+      end,
+      Protocol           = function(value) -- the app takes compact lines
+        MIDI2LR.COMPACT = tonumber(value) >= PROTOCOL
+      end,
     }
 
     local function MIDIValueToLRValue(param, midi_value)
@@ -349,46 +358,9 @@ LrTasks.startAsyncTask(
     end
 
     --called within LrRecursionGuard for setting
-    function UpdateParamPickup() --closure
-      local paramlastmoved = {}
-      local lastfullrefresh = 0
-      return function(param, midi_value)
-        local value
-        if LrApplicationView.getCurrentModuleName() ~= 'develop' then
-          LrApplicationView.switchToModule('develop')
-        end
-        if Limits.Parameters[param] then
-          Limits.ClampValue(param)
-        end
-        if((math.abs(midi_value - LRValueToMIDIValue(param)) <= PICKUP_THRESHOLD) or (paramlastmoved[param] ~= nil and paramlastmoved[param] + 0.5 > os.clock())) then -- pickup succeeded
-          paramlastmoved[param] = os.clock()
-          value = MIDIValueToLRValue(param, midi_value)
-          MIDI2LR.PARAM_OBSERVER[param] = value
-          LrDevelopController.setValue(param, value)
-          LastParam = param
-          if ProgramPreferences.ClientShowBezelOnChange then
-            LrDialogs.showBezel(param..'  '..LrStringUtils.numberToStringWithSeparators(value,Ut.precision(value)))
-          end
-          if ParamList.ProfileMap[param] then
-            Profiles.changeProfile(ParamList.ProfileMap[param])
-          end
-        else --failed pickup
-          if ProgramPreferences.ClientShowBezelOnChange then -- failed pickup. do I display bezel?
-            value = MIDIValueToLRValue(param, midi_value)
-            local actualvalue = LrDevelopController.getValue(param)
-            local precision = Ut.precision(value)
-            LrDialogs.showBezel(param..'  '..LrStringUtils.numberToStringWithSeparators(value,precision)..'  '..LrStringUtils.numberToStringWithSeparators(actualvalue,precision))
-          end
-          if lastfullrefresh + 1 < os.clock() then --try refreshing controller once a second
-            CU.FullRefresh()
-            lastfullrefresh = os.clock()
-          end
-        end -- end of if pickup/elseif bezel group
-      end -- end of returned function
-    end
-    UpdateParamPickup = UpdateParamPickup() --complete closure
-    --called within LrRecursionGuard for setting
-    function UpdateParamNoPickup(param, midi_value) 
+    -- values arrive already picked up: the app holds back a control's values
+    -- until it reaches the parameter's value
+    local function UpdateParam(param, midi_value)
       local value
       if LrApplicationView.getCurrentModuleName() ~= 'develop' then
         LrApplicationView.switchToModule('develop')
@@ -404,7 +376,6 @@ LrTasks.startAsyncTask(
         Profiles.changeProfile(ParamList.ProfileMap[param])
       end
     end
-    UpdateParam = UpdateParamPickup --initial state
 
 
     LrFunctionContext.callWithContext( 
@@ -420,17 +391,31 @@ LrTasks.startAsyncTask(
         --call following within guard for reading
         local function AdjustmentChangeObserver(observer)
           if LrApplicationView.getCurrentModuleName() == 'develop' then
+            local values = {}
             for _,param in ipairs(ParamList.SendToMidi) do
               local lrvalue = LrDevelopController.getValue(param)
               if observer[param] ~= lrvalue and type(lrvalue) == 'number' then
-                MIDI2LR.SERVER:send(string.format('%s %g\n', param, LRValueToMIDIValue(param)))
+                values[#values+1] = {param, LRValueToMIDIValue(param)}
                 observer[param] = lrvalue
                 LastParam = param
               end
             end
+            CU.SendValues(values)
           end
         end
         local function InactiveObserver() end
+        -- value is the text after the command, or a number from a compact line
+        local function ProcessMessage(param, value)
+          if(ACTIONS[param]) then -- perform a one time action
+            if(tonumber(value) > BUTTON_ON) then ACTIONS[param]() end
+          elseif(param:find('Reset') == 1) then -- perform a reset other than those explicitly coded in ACTIONS array
+            if(tonumber(value) > BUTTON_ON) then Ut.execFOM(LrDevelopController.resetToDefault,param:sub(6)) end
+          elseif(SETTINGS[param]) then -- do something requiring the transmitted value to be known
+            SETTINGS[param](value)
+          else -- otherwise update a develop parameter
+            guardsetting:performWithGuard(UpdateParam,param,tonumber(value))
+          end
+        end
         CurrentObserver = AdjustmentChangeObserver -- will change when detect loss of MIDI controller
 
         -- wrapped in function so can be called when connection lost
@@ -440,6 +425,9 @@ LrTasks.startAsyncTask(
             plugin = _PLUGIN,
             port = SEND_PORT,
             mode = 'send',
+            onConnected = function( socket ) -- offer compact lines
+              socket:send(string.format('Protocol %d\n', PROTOCOL))
+            end,
             onClosed = function( ) -- this callback never seems to get called...
               -- MIDI2LR closed connection, allow for reconnection
               -- socket:reconnect()
@@ -457,22 +445,23 @@ LrTasks.startAsyncTask(
           mode = 'receive',
           onMessage = function(_, message) --message processor
             if type(message) == 'string' then
-              local split = message:find(' ',1,true)
-              local param = message:sub(1,split-1)
-              local value = message:sub(split+1)
-              if(ACTIONS[param]) then -- perform a one time action
-                if(tonumber(value) > BUTTON_ON) then ACTIONS[param]() end
-              elseif(param:find('Reset') == 1) then -- perform a reset other than those explicitly coded in ACTIONS array
-                if(tonumber(value) > BUTTON_ON) then Ut.execFOM(LrDevelopController.resetToDefault,param:sub(6)) end
-              elseif(SETTINGS[param]) then -- do something requiring the transmitted value to be known
-                SETTINGS[param](value)
-              else -- otherwise update a develop parameter
-                guardsetting:performWithGuard(UpdateParam,param,tonumber(value))
+              if message:sub(1,1) == '~' then -- compact line: ids and values only
+                for i = 2, #message - 5, 6 do
+                  local b1, b2, b3, b4, b5, b6 = message:byte(i, i + 5)
+                  local param = CommandNames[(b1-48)*4096 + (b2-48)*64 + (b3-48)]
+                  if param then
+                    ProcessMessage(param, ((b4-48)*4096 + (b5-48)*64 + (b6-48)) / 65535)
+                  end
+                end
+              else
+                local split = message:find(' ',1,true)
+                ProcessMessage(message:sub(1,split-1), message:sub(split+1))
               end
             end
           end,
           onClosed = function( socket )
             -- MIDI2LR closed connection, allow for reconnection
+            MIDI2LR.COMPACT = false -- until the app names the ids again
             socket:reconnect()
             -- calling SERVER:reconnect causes LR to hang for some reason...
             MIDI2LR.SERVER:close()
@@ -232,15 +232,51 @@ local function AddToCollection()
 end
 AddToCollection = AddToCollection() --closure
 
+-- compact line form of a value: three 6-bit digits from '0' each for the id
+-- and the value scaled to 0-65535. see CompactProtocol.h in the app
+local COMPACT_PER_LINE = 32 -- keeps lines within the app's line buffer
+local function EncodeCompact(id, value)
+  local scaled = math.floor(math.min(math.max(value, 0), 1) * 65535 + 0.5)
+  return string.char(48 + math.floor(id / 4096) % 64, 48 + math.floor(id / 64) % 64,
+    48 + id % 64, 48 + math.floor(scaled / 4096) % 64, 48 + math.floor(scaled / 64) % 64,
+    48 + scaled % 64)
+end
+
+-- sends {{param, value}, ...} (values 0-1) to the app in one write: as
+-- compact lines once the app has named the command ids, else as text lines
+local function SendValues(values)
+  local lines, compact = {}, {}
+  for _,v in ipairs(values) do
+    local id = MIDI2LR.COMPACT and MIDI2LR.COMMAND_IDS[v[1]]
+    if id then
+      compact[#compact+1] = EncodeCompact(id, v[2])
+      if #compact == COMPACT_PER_LINE then
+        lines[#lines+1] = '~'..table.concat(compact)..'\n'
+        compact = {}
+      end
+    else
+      lines[#lines+1] = string.format('%s %g\n', v[1], v[2])
+    end
+  end
+  if #compact > 0 then
+    lines[#lines+1] = '~'..table.concat(compact)..'\n'
+  end
+  if #lines > 0 then
+    MIDI2LR.SERVER:send(table.concat(lines))
+  end
+end
+
 local function FullRefresh()
+  local values = {}
   for _,param in ipairs(ParamList.SendToMidi) do
     local min,max = Limits.GetMinMax(param)
     local lrvalue = LrDevelopController.getValue(param)
     if type(min) == 'number' and type(max) == 'number' and type(lrvalue) == 'number' then
       local midivalue = (lrvalue-min)/(max-min)
-      MIDI2LR.SERVER:send(string.format('%s %g\n', param, midivalue))
+      values[#values+1] = {param, midivalue}
     end
   end
+  SendValues(values)
 end
 
 
@@ -256,5 +292,6 @@ return {
   FullRefresh = FullRefresh,
   PasteSelectedSettings = PasteSelectedSettings,
   PasteSettings = PasteSettings,
+  SendValues = SendValues,
 
 }
@@ -64,8 +64,8 @@ for _,v in ipairs(Database.DataBase) do
     file:write('"'..v[8]..'",\n')
   end
 end
-menus_ = menus_ .. '"Next/Prev Profile" })'
-menu_entries_ = menu_entries_ .. 'LRCommandList::NextPrevProfile })'
+menus_ = menus_ .. '"Next/Prev Profile", "Mapping Banks" })'
+menu_entries_ = menu_entries_ .. 'LRCommandList::NextPrevProfile, LRCommandList::BankSelect })'
 lrcommandsh = lrcommandsh .. '\n'
 
 file:write("};\n\nconst std::vector<String> LRCommandList::LRStringList = {\n\"Unmapped\",\n")
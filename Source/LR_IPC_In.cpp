@@ -19,112 +19,53 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "LR_IPC_In.h"
+#include "CompactProtocol.h"
+#include "LRCommands.h"
 #include "Utilities/Utilities.h"
 #include <bitset>
 #include <stdexcept>
 
 namespace {
-  constexpr int kBufferSize = 256;
-  constexpr int kConnectTryTime = 100;
-  constexpr int kEmptyWait = 100;
-  constexpr auto kHost = "127.0.0.1";
-  constexpr int kLrInPort = 58764;
-  constexpr double kMaxMIDI = 127.0;
-  constexpr double kMaxNRPN = 16383.0;
-  constexpr int kNotConnectedWait = 333;
-  constexpr int kReadyWait = 0;
-  constexpr int kStopWait = 1000;
-  constexpr int kTimerInterval = 1000;
-}
-
-LR_IPC_IN::LR_IPC_IN(): juce::StreamingSocket{}, juce::Thread{"LR_IPC_IN"} {}
-
-LR_IPC_IN::~LR_IPC_IN() {
-  {
-    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-    timer_off_ = true;
-    juce::Timer::stopTimer();
-  }
-  juce::Thread::stopThread(kStopWait);
-  juce::StreamingSocket::close();
+  constexpr size_t kBufferSize = 256;
 }
 
 void LR_IPC_IN::Init(std::shared_ptr<CommandMap>& map_command,
   std::shared_ptr<ProfileManager>& profile_manager,
-  std::shared_ptr<MIDISender>& midi_sender) noexcept {
+  std::shared_ptr<MIDISender>& midi_sender,
+  std::shared_ptr<ParameterMirror>& parameter_mirror,
+  std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out,
+  std::shared_ptr<IOReactor>& io_reactor) noexcept {
   command_map_ = map_command;
+  lr_ipc_out_ = std::move(lr_ipc_out);
   profile_manager_ = profile_manager;
   midi_sender_ = midi_sender;
-  //start the timer
-  juce::Timer::startTimer(kTimerInterval);
+  parameter_mirror_ = parameter_mirror;
+  line_.reserve(kBufferSize);
+  if (io_reactor)
+    io_reactor->Init(this);
 }
 
-void LR_IPC_IN::PleaseStopThread() {
-  juce::Thread::signalThreadShouldExit();
-  juce::Thread::notify();
+void LR_IPC_IN::bytesReceived(const char* data, size_t size) {
+  for (const auto* end = data + size; data != end; ++data) {
+    if (skipping_) {
+      skipping_ = *data != '\n';
+      continue;
+    }
+    line_.push_back(*data);
+    if (*data == '\n') {
+      processLine(line_);
+      line_.clear();
+    }
+    else if (line_.size() == kBufferSize) { // not from the plugin: drop it
+      line_.clear();
+      skipping_ = true;
+    }
+  }
 }
 
-void LR_IPC_IN::run() {
-  while (!juce::Thread::threadShouldExit()) {
-    //if not connected, executes a wait 333 then goes back to while
-    //if connected, tries to read a line, checks thread status and connection
-    //status before each read attempt
-    //doesn't terminate thread if disconnected, as currently don't have graceful
-    //way to restart thread
-    if (!juce::StreamingSocket::isConnected()) {
-      juce::Thread::wait(kNotConnectedWait);
-    } //end if (is not connected)
-    else {
-      char line[kBufferSize + 1] = {'\0'};//plus one for \0 at end
-      auto size_read = 0;
-      auto can_read_line = true;
-      // parse input until we have a line, then process that line, quit if
-      // connection lost
-      while (std::string(line).back() != '\n' && juce::StreamingSocket::isConnected()) {
-        if (juce::Thread::threadShouldExit())
-          goto threadExit;//break out of nested whiles
-        const auto wait_status = juce::StreamingSocket::waitUntilReady(true, kReadyWait);
-        switch (wait_status) {
-          case -1:
-            can_read_line = false;
-            goto dumpLine; //read line failed, break out of switch and while
-          case 0:
-            juce::Thread::wait(kEmptyWait);
-            break; //try again to read until char shows up
-          case 1:
-            if (size_read == kBufferSize)
-              throw std::out_of_range("Buffer overflow in LR_IPC_IN");
-            size_read += juce::StreamingSocket::read(line + size_read, 1, false);
-            break;
-        }
-      } // end while !\n and is connected
-
-      // if lose connection, line may not be terminated
-      {
-        std::string param{line};
-        if (can_read_line && param.back() == '\n') {
-          processLine(param);
-        }
-      } //scope param
-    dumpLine: /* empty statement */;
-    } //end else (is connected)
-  } //while not threadshouldexit
-threadExit: /* empty statement */;
-  std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-  timer_off_ = true;
-  juce::Timer::stopTimer();
-  //thread_started_ = false; //don't change flag while depending upon it
-}
-
-void LR_IPC_IN::timerCallback() {
-  std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-  if (!timer_off_ && !juce::StreamingSocket::isConnected()) {
-    if (juce::StreamingSocket::connect(kHost, kLrInPort, kConnectTryTime))
-      if (!thread_started_) {
-        juce::Thread::startThread(); //avoid starting thread during shutdown
-        thread_started_ = true;
-      }
-  }
+void LR_IPC_IN::receiverReset() {
+  line_.clear(); // a line cut off by a lost connection isn't processed
+  skipping_ = false;
 }
 
 void LR_IPC_IN::processLine(const std::string& line) {
@@ -132,16 +73,28 @@ void LR_IPC_IN::processLine(const std::string& line) {
     {"SwitchProfile",1},
     {"SendKey",2},
     {"TerminateApplication",3},
+    {"Protocol",4},
   };
+  if (!line.empty() && line.front() == CompactProtocol::kMarker) {
+    // values only, by id: no trimming or number parsing
+    size_t command_id;
+    double value;
+    for (size_t position = 1; position + CompactProtocol::kUpdateSize <= line.size();
+      position += CompactProtocol::kUpdateSize)
+      if (CompactProtocol::Decode(line.data() + position, command_id, value) &&
+        command_id < LRCommandList::LRStringList.size())
+        ReceiveValue_(LRCommandList::LRStringList[command_id], command_id, value);
+    return;
+  }
     // process input into [parameter] [Value]
   const auto trimmed_line = RSJ::trim(line);
   const auto command = trimmed_line.substr(0, trimmed_line.find(' '));
   const auto value_string = trimmed_line.substr(trimmed_line.find(' ') + 1);
 
   switch (cmds.count(command) ? cmds.at(command) : 0) {
-    case 1: //SwitchProfile
+    case 1: //SwitchProfile, loaded on the message thread
       if (profile_manager_)
-        profile_manager_->switchToProfile(value_string);
+        profile_manager_->QueueProfile(value_string);
       break;
     case 2: //SendKey
       {
@@ -152,18 +105,26 @@ void LR_IPC_IN::processLine(const std::string& line) {
         break;
       }
     case 3: //TerminateApplication
-      PleaseStopThread();
       JUCEApplication::getInstance()->systemRequestedQuit();
       break;
+    case 4: //Protocol, the plugin can take compact lines
+      if (const auto ptr = lr_ipc_out_.lock())
+        ptr->SetPeerProtocol(std::stoi(value_string));
+      break;
     case 0:
-      // send associated CC messages to MIDI OUT devices
-      if (command_map_ && midi_sender_ ) {
-        const auto original_value = std::stod(value_string);
-        for (const auto msg : command_map_->getMessagesForCommand(command)) {
-          const auto value = static_cast<int>(round(
-            ((msg->controller < 128) ? kMaxMIDI : kMaxNRPN) * original_value));
-          midi_sender_->sendCC(msg->channel, msg->controller, value);
-        }
-      }
+      ReceiveValue_(command, LRCommandList::getIndexOfCommand(command),
+        std::stod(value_string));
+  }
+}
+
+void LR_IPC_IN::ReceiveValue_(const std::string& command, size_t command_id,
+  double value) {
+  if (parameter_mirror_)
+    parameter_mirror_->Set(command_id, value);
+  // send associated CC messages to MIDI OUT devices
+  if (command_map_ && midi_sender_) {
+    const auto commands = command_map_->getSnapshot();
+    for (const auto& msg : commands->getMessagesForCommand(command))
+      midi_sender_->sendValue(msg, commands->midiValue(msg, value));
   }
 }
\ No newline at end of file
@@ -28,37 +28,43 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <unordered_map>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CommandMap.h"
+#include "IOReactor.h"
+#include "LR_IPC_OUT.h"
 #include "MIDISender.h"
+#include "ParameterMirror.h"
 #include "ProfileManager.h"
 #include "SendKeys.h"
 
-class LR_IPC_IN final:
-  private juce::StreamingSocket,
-  private juce::Timer,
-  private juce::Thread {
+class LR_IPC_IN final: private IOReceiver {
+  // Lines from the plugin. The IOReactor reads them from the socket and
+  // calls here on its thread.
 public:
-  LR_IPC_IN();
-  virtual ~LR_IPC_IN();
+  LR_IPC_IN() noexcept {};
+  virtual ~LR_IPC_IN() {};
   void Init(std::shared_ptr<CommandMap>& mapCommand,
     std::shared_ptr<ProfileManager>& profileManager,
-    std::shared_ptr<MIDISender>& midiSender) noexcept;
-  //signal exit to thread
-  void PleaseStopThread(void);
+    std::shared_ptr<MIDISender>& midiSender,
+    std::shared_ptr<ParameterMirror>& parameterMirror,
+    std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out,
+    std::shared_ptr<IOReactor>& io_reactor) noexcept;
 private:
-  // Thread interface
-  virtual void run() override;
-  // Timer callback
-  virtual void timerCallback() override;
+  // IOReceiver interface
+  virtual void bytesReceived(const char* data, size_t size) override;
+  virtual void receiverReset() override;
   // process a line received from the socket
   void processLine(const std::string& line);
+  // a parameter's value reported by the plugin; command_id is its index in
+  // LRCommandList::LRStringList, 0 if it isn't there
+  void ReceiveValue_(const std::string& command, size_t command_id, double value);
 
-  bool thread_started_{false};
-  bool timer_off_{false};
-  mutable std::mutex timer_mutex_;
+  std::string line_; // reactor thread only, the line being received
+  bool skipping_{false}; // past the end of an overlong line
   SendKeys send_keys_;
   std::shared_ptr<CommandMap> command_map_{nullptr};
   std::shared_ptr<MIDISender> midi_sender_{nullptr};
+  std::shared_ptr<ParameterMirror> parameter_mirror_{nullptr};
   std::shared_ptr<ProfileManager> profile_manager_{nullptr};
+  std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
 };
 
 #endif  // LR_IPC_IN_H_INCLUDED
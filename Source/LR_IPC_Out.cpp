@@ -19,130 +19,237 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "LR_IPC_OUT.h"
-#include "CommandMap.h"
+#include "CompactProtocol.h"
 #include "LRCommands.h"
 
+constexpr int LR_IPC_OUT::kDefaultCoalesceWindow;
+
 namespace {
-  constexpr int kConnectTryTime = 100;
-  constexpr auto kHost = "127.0.0.1";
-  constexpr int kLrOutPort = 58763;
-  constexpr double kMaxMIDI = 127.0;
-  constexpr double kMaxNRPN = 16383.0;
-  constexpr int kTimerInterval = 1000;
+  constexpr int kFlushTimer = 0;
+  constexpr size_t kCommandIdsPerLine = 16;
+
+  // "CommandIds <first id> <name>...\n" lines for all of LRStringList, names
+  // cut at the first space as the plugin reads them
+  const std::string& CommandIdLines() {
+    static const auto lines = [] {
+      std::string text;
+      const auto& commands = LRCommandList::LRStringList;
+      for (size_t id = 0; id < commands.size(); ++id) {
+        if (id % kCommandIdsPerLine == 0)
+          text += "CommandIds " + std::to_string(id);
+        text += ' ' + commands[id].substr(0, commands[id].find(' '));
+        if (id % kCommandIdsPerLine == kCommandIdsPerLine - 1 || id + 1 == commands.size())
+          text += '\n';
+      }
+      return text;
+    }();
+    return lines;
+  }
 }
 
-LR_IPC_OUT::LR_IPC_OUT(): juce::InterprocessConnection() {}
+LR_IPC_OUT::LR_IPC_OUT():
+  coalesce_window_ms_{kDefaultCoalesceWindow} {}
 
 LR_IPC_OUT::~LR_IPC_OUT() {
-  {
-    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-    timer_off_ = true;
-    juce::Timer::stopTimer();
-  }
-  juce::InterprocessConnection::disconnect();
-  command_map_.reset();
+  juce::MultiTimer::stopTimer(kFlushTimer);
 }
 
-void LR_IPC_OUT::Init(std::shared_ptr<CommandMap>& command_map,
-  std::shared_ptr<MIDIProcessor>& midi_processor) {
-    //copy the pointer
-  command_map_ = command_map;
-
+void LR_IPC_OUT::Init(std::shared_ptr<MIDIProcessor>& midi_processor,
+  std::shared_ptr<IOReactor>& io_reactor) {
+  // commands arrive already resolved, so no command map is needed
   if (midi_processor) {
-    midi_processor->addMIDICommandListener(this);
+    midi_processor->addMIDICommandListener(this, MIDI_SUBSCRIPTION::LR_PARAMETER);
   }
-
-  //start the timer
-  juce::Timer::startTimer(kTimerInterval);
+  io_reactor_ = io_reactor;
+  // first, so the connection is set up before other listeners send to it
+  if (io_reactor_)
+    io_reactor_->addListener(this);
 }
 
 void LR_IPC_OUT::addListener(LRConnectionListener *listener) {
-  for (const auto current_listener : listeners_)
-    if (current_listener == listener)
-      return; //don't add duplicates
-  listeners_.push_back(listener);
+  if (io_reactor_)
+    io_reactor_->addListener(listener);
 }
 
 void LR_IPC_OUT::sendCommand(const std::string& command) {
   {
     std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-    command_ += command;
+    command_queue_.PushLine(command);
   }
   juce::AsyncUpdater::triggerAsyncUpdate();
 }
 
-void LR_IPC_OUT::handleMidiCC(int midi_channel, int controller, int value) {
-  MIDI_Message_ID message{midi_channel, controller, true};
-
-  if (command_map_) {
-    if (!command_map_->messageExistsInMap(message) ||
-      command_map_->getCommandforMessage(message) == "Unmapped" ||
-      find(LRCommandList::NextPrevProfile.begin(),
-        LRCommandList::NextPrevProfile.end(),
-        command_map_->getCommandforMessage(message)) != LRCommandList::NextPrevProfile.end())
-      return;
+void LR_IPC_OUT::handleMidiCommand(const MIDI_Command_Event& event) {
+  {
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    // a macro's commands are queued together, so they go out in one write
+    if (event.message.msg_type == MIDI_MSG_TYPE::NOTE) {
+      command_queue_.PushDiscreteValue(*event.command, 1.0);
+      for (const auto* command : event.macro)
+        command_queue_.PushDiscreteValue(*command, 1.0);
+    }
+    else if (event.macro.empty()) // command ids start with LRStringList
+      command_queue_.PushValue(*event.command, event.command_id, event.lr_value);
+    else if (event.value < event.max_value)
+      macro_held_.erase(event.message);
+    else if (macro_held_.insert(event.message).second) {
+      // a macro on a control fires once as it reaches its top, like a button
+      command_queue_.PushDiscreteValue(*event.command, 1.0);
+      for (const auto* command : event.macro)
+        command_queue_.PushDiscreteValue(*command, 1.0);
+    }
+  }
+  juce::AsyncUpdater::triggerAsyncUpdate();
+}
 
-    auto command_to_send = command_map_->getCommandforMessage(message);
-    double computed_value = value;
-    computed_value /= (controller < 128) ? kMaxMIDI : kMaxNRPN;
+void LR_IPC_OUT::connected() {
+  connected_ = true;
+  // nothing left from an earlier connection may start this one mid-line
+  send_buffer_.clear();
+  sent_ = 0;
+  SetCongested_(false);
+  // have the plugin report every parameter, seeding the values relative
+  // encoders step from and bringing MIDI OUT devices up to date
+  sendCommand("FullRefresh 1\n");
+  StartCompact_();
+}
 
-    command_to_send += ' ' + std::to_string(computed_value) + '\n';
-    {
-      std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-      command_ += command_to_send;
+void LR_IPC_OUT::disconnected() {
+  connected_ = false;
+  compact_ = false;
+  send_buffer_.clear();
+  sent_ = 0;
+  SetCongested_(false);
+  // the plugin that reconnects may be an older one, unless it has already
+  // announced itself on its new connection
+  const auto connection = io_reactor_->ReceiveConnection();
+  {
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    if (peer_connection_ != connection || connection == 0) {
+      peer_protocol_ = 1;
+      peer_connection_ = 0;
     }
-    juce::AsyncUpdater::triggerAsyncUpdate();
+    command_queue_.SetCompact(false);
   }
 }
 
-void LR_IPC_OUT::handleMidiNote(int midi_channel, int note) {
-  MIDI_Message_ID message{midi_channel, note, false};
+void LR_IPC_OUT::SetCoalesceWindow(int milliseconds) noexcept {
+  coalesce_window_ms_.store(milliseconds > 0 ? milliseconds : 0,
+    std::memory_order_relaxed);
+}
 
-  if (command_map_) {
-    if (!command_map_->messageExistsInMap(message) ||
-      command_map_->getCommandforMessage(message) == "Unmapped" ||
-      find(LRCommandList::NextPrevProfile.begin(),
-        LRCommandList::NextPrevProfile.end(),
-        command_map_->getCommandforMessage(message)) != LRCommandList::NextPrevProfile.end())
-      return;
+void LR_IPC_OUT::SetQueueLimit(size_t entries, QUEUE_FULL_POLICY policy) {
+  std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+  command_queue_.SetLimit(entries, policy);
+}
 
-    auto command_to_send = command_map_->getCommandforMessage(message);
-    command_to_send += " 1\n";
-    {
-      std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-      command_ += command_to_send;
-    }
-    juce::AsyncUpdater::triggerAsyncUpdate();
-  }
+LR_IPC_OUT::QueueStatistics LR_IPC_OUT::GetQueueStatistics() const {
+  std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+  return {command_queue_.size(), command_queue_.high_water(),
+    command_queue_.merged(), command_queue_.dropped(),
+    command_queue_.latency(OUTBOUND_LANE::ACTIONS),
+    command_queue_.latency(OUTBOUND_LANE::VALUES)};
 }
 
-void LR_IPC_OUT::connectionMade() {
-  for (const auto& listener : listeners_)
-    listener->connected();
+bool LR_IPC_OUT::IsCongested() const noexcept {
+  return congested_.load(std::memory_order_relaxed);
 }
 
-void LR_IPC_OUT::connectionLost() {
-  for (const auto& listener : listeners_)
-    listener->disconnected();
+void LR_IPC_OUT::SetPeerProtocol(int version) {
+  const auto connection = io_reactor_->ReceiveConnection();
+  {
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    peer_protocol_ = version;
+    peer_connection_ = connection;
+  }
+  juce::AsyncUpdater::triggerAsyncUpdate(); // StartCompact_ on the message thread
 }
 
-void LR_IPC_OUT::messageReceived(const juce::MemoryBlock& /*msg*/) {}
+void LR_IPC_OUT::StartCompact_() {
+  if (compact_ || !connected_)
+    return;
+  {
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    if (peer_protocol_ < CompactProtocol::kVersion)
+      return;
+    compact_ = true;
+    command_queue_.PushLine(CommandIdLines());
+    command_queue_.PushLine("Protocol " + std::to_string(CompactProtocol::kVersion) +
+      '\n');
+    command_queue_.SetCompact(true);
+  }
+}
 
 void LR_IPC_OUT::handleAsyncUpdate() {
-  std::string command_copy;
+  StartCompact_();
+  // send at most once per window; the flush timer picks up whatever arrives
+  // in the meantime, so the last value of a gesture is always sent. actions
+  // go at once, taking the values queued so far with them
+  bool urgent;
   {
     std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-    command_copy.swap(command_);
+    urgent = command_queue_.urgent();
   }
-    //check if there is a connection
-  if (juce::InterprocessConnection::isConnected()) {
-    juce::InterprocessConnection::getSocket()->
-      write(command_copy.c_str(), command_copy.length());
+  const auto window =
+    static_cast<juce::uint32>(coalesce_window_ms_.load(std::memory_order_relaxed));
+  const auto elapsed = juce::Time::getMillisecondCounter() - last_flush_ms_;
+  if (!urgent && elapsed < window) {
+    if (!juce::MultiTimer::isTimerRunning(kFlushTimer))
+      juce::MultiTimer::startTimer(kFlushTimer, static_cast<int>(window - elapsed));
+    return;
   }
+  Flush_();
+}
+
+void LR_IPC_OUT::Flush_() {
+  last_flush_ms_ = juce::Time::getMillisecondCounter();
+  // until the last batch is written, new values wait in the queue, where
+  // they are merged
+  if (sent_ == send_buffer_.size()) {
+    send_buffer_.clear(); // keeps its capacity
+    sent_ = 0;
+    batch_connection_ = io_reactor_ ? io_reactor_->SendConnection() : 0;
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    command_queue_.Drain(send_buffer_);
+  }
+  Write_();
+}
+
+void LR_IPC_OUT::Write_() {
+  while (sent_ < send_buffer_.size()) {
+    // a batch goes only to the connection it was begun on; if that is lost,
+    // the rest is dropped and the reactor reports the loss
+    const auto written = batch_connection_ ? io_reactor_->Write(send_buffer_.data() +
+      sent_, send_buffer_.size() - sent_, batch_connection_) : -1;
+    if (written < 0) {
+      send_buffer_.clear();
+      sent_ = 0;
+      break;
+    }
+    if (written == 0)
+      break;
+    sent_ += static_cast<size_t>(written);
+  }
+  const auto congested = sent_ < send_buffer_.size();
+  SetCongested_(congested);
+  if (congested) // the reactor calls writable() when the socket has room
+    io_reactor_->WaitWritable();
+}
+
+void LR_IPC_OUT::writable() {
+  Write_();
+}
+
+void LR_IPC_OUT::SetCongested_(bool congested) {
+  if (congested_.exchange(congested, std::memory_order_relaxed) == congested)
+    return;
+  if (!congested) // send what queued meanwhile
+    juce::AsyncUpdater::triggerAsyncUpdate();
+  if (io_reactor_)
+    io_reactor_->NotifyCongestion(congested);
 }
 
-void LR_IPC_OUT::timerCallback() {
-  std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-  if (!timer_off_ && !juce::InterprocessConnection::isConnected())
-    juce::InterprocessConnection::connectToSocket(kHost, kLrOutPort, kConnectTryTime);
+void LR_IPC_OUT::timerCallback(int timer_id) {
+  juce::MultiTimer::stopTimer(timer_id);
+  Flush_();
 }
\ No newline at end of file
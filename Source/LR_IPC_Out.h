@@ -22,64 +22,101 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef LR_IPC_OUT_H_INCLUDED
 #define LR_IPC_OUT_H_INCLUDED
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "Utilities/Utilities.h"
-#include "CommandMap.h"
+#include "IOReactor.h"
 #include "MIDIProcessor.h"
-
-class LRConnectionListener {
-public:
-    // sent when a connection to the LR plugin is made
-  virtual void connected() = 0;
-
-  // sent if disconnected from the LR plugin
-  virtual void disconnected() = 0;
-
-  virtual ~LRConnectionListener() {};
-///< .
-};
+#include "OutboundQueue.h"
 
 class LR_IPC_OUT final:
-  private juce::InterprocessConnection,
   public MIDICommandListener,
+  private LRConnectionListener,
   private juce::AsyncUpdater,
-  private juce::Timer {
+  private juce::MultiTimer {
 public:
   LR_IPC_OUT();
   virtual ~LR_IPC_OUT();
-  void Init(std::shared_ptr<CommandMap>&  mapCommand,
-    std::shared_ptr<MIDIProcessor>&  midiProcessor);
+  void Init(std::shared_ptr<MIDIProcessor>&  midiProcessor,
+    std::shared_ptr<IOReactor>& io_reactor);
 
+  // listeners are kept by the IOReactor, after this, which tells them of
+  // the connection to the plugin
   void addListener(LRConnectionListener *listener);
 
   // sends a command to the plugin
   void sendCommand(const std::string& command);
 
   // MIDICommandListener interface
-  virtual void handleMidiCC(int midiChannel, int controller, int value) override;
-  virtual void handleMidiNote(int midiChannel, int note) override;
+  virtual void handleMidiCommand(const MIDI_Command_Event& event) override;
+
+  // values for the same command are merged and sent at most once per window
+  void SetCoalesceWindow(int milliseconds) noexcept;
+  static constexpr int kDefaultCoalesceWindow = 20; // milliseconds
+  // most entries the outbound queue holds, and what happens to values past
+  // that while the socket is behind
+  void SetQueueLimit(size_t entries, QUEUE_FULL_POLICY policy);
+
+  struct QueueStatistics {
+    size_t depth; // entries waiting to be written
+    size_t max_depth; // high-water mark since startup
+    size_t merged; // values replaced by a newer one for the same command
+    size_t dropped; // values discarded at the limit
+    OutboundQueue::LaneLatency actions; // from queueing to writing
+    OutboundQueue::LaneLatency values;
+  };
+  // snapshot of the outbound queue, safe to call from any thread
+  QueueStatistics GetQueueStatistics() const;
+
+  // whether bytes are waiting for the socket to take them; new values are
+  // merged in the queue meanwhile. safe to call from any thread
+  bool IsCongested() const noexcept;
+
+  // protocol version the plugin announced on the connection it is read
+  // from, see CompactProtocol.h; on the reactor thread
+  void SetPeerProtocol(int version);
 
 private:
-  // IPC interface
-  virtual void connectionMade() override;
-  virtual void connectionLost() override;
-  virtual void messageReceived(const juce::MemoryBlock& msg) override;
+  // LRConnectionListener interface
+  virtual void connected() override;
+  virtual void disconnected() override;
+  // the rest of a batch waiting for room is written
+  virtual void writable() override;
   // AsyncUpdater interface
   virtual void handleAsyncUpdate() override;
-  // Timer callback
-  virtual void timerCallback() override;
+  // MultiTimer callback
+  virtual void timerCallback(int timer_id) override;
+
+  void Flush_();
+  // writes as much of send_buffer_ as the socket takes without blocking
+  void Write_();
+  void SetCongested_(bool congested);
+  // names the command ids and switches to compact lines, if the plugin
+  // takes them and they aren't in use
+  void StartCompact_();
 
-  std::vector<LRConnectionListener *> listeners_;
-  bool timer_off_{false};
   mutable RSJ::spinlock command_mutex_; //fast spinlock for brief use
-  mutable std::mutex timer_mutex_; //fix race during shutdown
-  std::shared_ptr<const CommandMap> command_map_;
-  std::string command_;
+  OutboundQueue command_queue_;
+  std::shared_ptr<IOReactor> io_reactor_;
+  std::atomic<int> coalesce_window_ms_;
+  int peer_protocol_{1}; // guarded by command_mutex_
+  unsigned int peer_connection_{0}; // ReceiveConnection it was announced on
+  bool connected_{false}; // message thread only
+  bool compact_{false}; // message thread only
+  juce::uint32 last_flush_ms_{0}; // message thread only
+  std::string send_buffer_; // message thread only, reused by each flush
+  size_t sent_{0}; // bytes of send_buffer_ written, message thread only
+  unsigned int batch_connection_{0}; // that send_buffer_ is written to
+  std::atomic<bool> congested_{false};
+  // controls with a macro that are at their top and have fired it, guarded
+  // by command_mutex_
+  std::unordered_set<MIDI_Message_ID> macro_held_;
 };
 
 #endif  // LR_IPC_OUT_H_INCLUDED
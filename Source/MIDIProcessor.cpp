@@ -19,64 +19,471 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "MIDIProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-MIDIProcessor::MIDIProcessor() noexcept {}
+constexpr int MIDIProcessor::kDefaultNRPNTimeout;
 
-MIDIProcessor::~MIDIProcessor() {}
+namespace {
+  constexpr int kDispatchPriority = 8; // juce::Thread priorities run 0-10
+  constexpr int kStopWait = 1000;
+  constexpr int kDeviceScanInterval = 1000;
+  // relative encoders: a full sweep at rest speed, and acceleration
+  constexpr double kStepsPerRange = 256.0;
+  constexpr double kFastTick = 0.05; // seconds
+  constexpr double kMaxAcceleration = 8.0;
 
-void MIDIProcessor::Init(void) {
-  InitDevices_();
+  // everything not accepted here, including clock, active sensing and SysEx,
+  // is dropped by one lookup in the driver callback
+  void FillAcceptTable(const MIDI_InputFilter& filter,
+    std::array<bool, 256>& accept) noexcept {
+    accept.fill(false);
+    for (unsigned int channel = 0u; channel < 16u; ++channel) {
+      if (((filter.channels >> channel) & 1u) == 0u)
+        continue;
+      accept[0x90u | channel] = filter.notes;
+      accept[0xA0u | channel] = filter.pressure;
+      accept[0xB0u | channel] = filter.controllers;
+      accept[0xD0u | channel] = filter.pressure;
+      accept[0xE0u | channel] = filter.pitch_bend;
+    }
+  }
+
+  // index of the device named name in the driver's list as it is now,
+  // counting from 0 among devices of that name; -1 if it has gone. the list
+  // may have changed since it was scanned, and devices are opened by index
+  int CurrentDeviceIndex(const juce::String& name, int twin) {
+    const auto devices = juce::MidiInput::getDevices();
+    for (auto idx = 0; idx < devices.size(); ++idx)
+      if (devices[idx] == name && twin-- == 0)
+        return idx;
+    return -1;
+  }
 }
 
-void MIDIProcessor::handleIncomingMidiMessage(juce::MidiInput * /*device*/,
+MIDIProcessor::MIDIProcessor() noexcept: juce::Thread{"MIDIProcessor"},
+  nrpn_timeout_ms_{kDefaultNRPNTimeout} {}
+
+MIDIProcessor::~MIDIProcessor() {
+  juce::Timer::stopTimer();
+  CloseDevices_();
+  juce::Thread::stopThread(kStopWait);
+}
+
+void MIDIProcessor::Init(std::shared_ptr<CommandMap>& command_map,
+  std::shared_ptr<ParameterMirror>& parameter_mirror,
+  std::shared_ptr<MIDISender>& midi_sender) {
+  command_map_ = command_map;
+  command_map_->addBankListener(this);
+  parameter_mirror_ = parameter_mirror;
+  midi_sender_ = midi_sender;
+  UpdateDevices_(juce::MidiInput::getDevices());
+  juce::Thread::startThread(kDispatchPriority);
+  juce::Timer::startTimer(kDeviceScanInterval);
+}
+
+void MIDIProcessor::handleIncomingMidiMessage(juce::MidiInput * device,
   const juce::MidiMessage& message) {
-  if (message.isController()) {
-    const auto channel =
-      static_cast<unsigned short int>(message.getChannel()); // 1-based
-    const auto control =
-      static_cast<unsigned short int>(message.getControllerNumber());
-    const auto value =
-      static_cast<unsigned short int>(message.getControllerValue());
-    if (nrpn_filter_.ProcessMidi(channel, control, value)) { //true if nrpn piece
-      if (nrpn_filter_.IsReady(channel)) { //send when finished
-        for (const auto& listener : listeners_)
-          listener->handleMidiCC(channel, nrpn_filter_.GetControl(channel),
-            nrpn_filter_.GetValue(channel));
-        nrpn_filter_.Clear(channel);
+  // runs on the driver thread: only decode and enqueue, never block
+  for (size_t id = 0; id < inputs_.size(); ++id) {
+    auto& slot = inputs_[id];
+    if (slot.input.load(std::memory_order_acquire) == device) {
+      const auto* raw = message.getRawData();
+      // accepted statuses are all channel messages; note-on with velocity 0
+      // is a note-off
+      if (!slot.accept[raw[0]] || ((raw[0] & 0xF0) == 0x90 && raw[2] == 0)) {
+        slot.rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      const MIDI_Event event{message.getTimeStamp(), static_cast<unsigned char>(id),
+        static_cast<unsigned char>(raw[0] & 0xF0),
+        static_cast<unsigned char>((raw[0] & 0x0F) + 1), raw[1],
+        static_cast<unsigned char>(message.getRawDataSize() > 2 ? raw[2] : 0)};
+      if (slot.queue.push(event)) {
+        const auto depth = slot.queue.size();
+        if (depth > slot.max_depth.load(std::memory_order_relaxed))
+          slot.max_depth.store(depth, std::memory_order_relaxed);
+        // only a sleeping dispatch thread is woken, see run(). notify() takes
+        // the thread's wait lock, so that first event after a sleep is the
+        // one that may briefly block here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.exchange(false))
+          juce::Thread::notify();
       }
+      else
+        slot.overflows.fetch_add(1, std::memory_order_relaxed);
+      return;
     }
-    else //regular message
-      for (const auto& listener : listeners_)
-        listener->handleMidiCC(channel, control, value);
   }
-  else if (message.isNoteOn()) {
-    for (const auto& listener : listeners_) {
-      listener->handleMidiNote(message.getChannel(), message.getNoteNumber());
+}
+
+void MIDIProcessor::run() {
+  while (!juce::Thread::threadShouldExit()) {
+    const auto wait_ms = DispatchPending_();
+    // the driver callbacks wake this thread only once it says it is going to
+    // sleep, so events arriving while it dispatches cost them no lock. an
+    // event queued just before the callback could see that is found here
+    sleeping_.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (AnyQueued_()) {
+      sleeping_.store(false);
+      continue;
+    }
+    // woken by the driver callbacks, or to time out held MSBs
+    juce::Thread::wait(wait_ms);
+    sleeping_.store(false);
+  }
+}
+
+bool MIDIProcessor::AnyQueued_() const noexcept {
+  for (const auto& slot : inputs_)
+    if (slot.queue.front())
+      return true;
+  return false;
+}
+
+int MIDIProcessor::DispatchPending_() {
+  std::lock_guard<decltype(dispatch_mutex_)> lock(dispatch_mutex_);
+  const auto now_ms = juce::Time::getMillisecondCounter();
+  const auto timeout_ms = nrpn_timeout_ms_.load(std::memory_order_relaxed);
+  for (;;) {
+    // merge the per-device queues, oldest event first
+    InputSlot* oldest = nullptr;
+    auto oldest_time = std::numeric_limits<double>::max();
+    for (auto& slot : inputs_) {
+      const auto* event = slot.queue.front();
+      if (event && event->timestamp < oldest_time) {
+        oldest = &slot;
+        oldest_time = event->timestamp;
+      }
+    }
+    if (oldest == nullptr)
+      break;
+    const auto event = *oldest->queue.front();
+    oldest->queue.pop_front();
+    DispatchEvent_(event, now_ms);
+  }
+  nrpn_filter_.ExpirePending(now_ms, static_cast<std::uint32_t>(timeout_ms),
+    [this](size_t device, unsigned short int channel) {SendNRPN_(device, channel); });
+  // a 14-bit MSB whose LSB doesn't follow goes out as the 7-bit CC it was
+  cc14_filter_.ExpireHeld(now_ms, static_cast<std::uint32_t>(timeout_ms),
+    [this](size_t device, unsigned short int channel,
+      unsigned short int control, unsigned short int msb) {
+    Publish_({channel, control, MIDI_MSG_TYPE::CC,
+      inputs_[device].device_id.load(std::memory_order_relaxed)}, msb,
+      127, juce::Time::getMillisecondCounterHiRes() * 0.001);
+  });
+  return nrpn_filter_.AnyPending() || cc14_filter_.AnyHeld() ? timeout_ms : -1;
+}
+
+void MIDIProcessor::SendNRPN_(size_t device, unsigned short int channel) {
+  Publish_({channel, nrpn_filter_.GetControl(device, channel), MIDI_MSG_TYPE::CC,
+    inputs_[device].device_id.load(std::memory_order_relaxed)},
+    nrpn_filter_.GetValue(device, channel), 16383,
+    juce::Time::getMillisecondCounterHiRes() * 0.001);
+  nrpn_filter_.Clear(device, channel);
+}
+
+void MIDIProcessor::Publish_(MIDI_Message_ID message, int value,
+  int max_value, double timestamp) {
+  if (!command_map_)
+    return;
+  // the snapshot keeps mapped and event.command valid through the dispatch
+  const auto commands = command_map_->getSnapshot();
+  const auto device = message.device;
+  const auto* mapped = commands->resolveCommand(message);
+  size_t macro_size = 0;
+  if (mapped)
+    for (const auto command_id : commands->getMacroIds(*mapped))
+      macro_commands_[macro_size++] = &commands->getCommandString(command_id);
+  const std::string* const* macro = macro_commands_.data();
+  MIDI_Command_Event event{message, device, value, max_value,
+    mapped ? commands->lrValue(*mapped, value, max_value) :
+    static_cast<double>(value) / max_value,
+    mapped ? &commands->getCommandString(mapped->command_id) : nullptr,
+    mapped ? mapped->command_id : CommandMap::kNoCommand,
+    mapped ? mapped->command_class : COMMAND_CLASS::UNMAPPED,
+    {macro, macro_size}, -1};
+  switch (event.command_class) {
+    case COMMAND_CLASS::LR_PARAMETER:
+      if (mapped->cc_mode != CC_MODE::ABSOLUTE && max_value == 127) {
+        auto absolute_event = event;
+        if (ApplyRelative_(absolute_event, mapped->cc_mode,
+          commands->getTransform(message), timestamp))
+          for (const auto& listener : parameter_listeners_)
+            listener->handleMidiCommand(absolute_event);
+      }
+      else {
+        // keep relative controls on the same parameter in step; the value
+        // Lightroom last reported decides pickup, with no round trip
+        if (parameter_mirror_ && message.msg_type != MIDI_MSG_TYPE::NOTE) {
+          double target;
+          if (!pickup_enabled_.load(std::memory_order_relaxed))
+            parameter_mirror_->Update(event.command_id, event.lr_value);
+          else if (!parameter_mirror_->PickUp(event.command_id, event.lr_value,
+            timestamp, target))
+            event.pickup_value = commands->midiValue(message, target);
+        }
+        if (event.pickup_value < 0)
+          for (const auto& listener : parameter_listeners_)
+            listener->handleMidiCommand(event);
+      }
+      break;
+    case COMMAND_CLASS::PROFILE_NAVIGATION:
+      for (const auto& listener : profile_listeners_)
+        listener->handleMidiCommand(event);
+      break;
+    case COMMAND_CLASS::BANK_SELECT:
+      // switched on the message thread, which calls bankSelected
+      if (value == max_value)
+        command_map_->QueueBankCommand(mapped->command_id);
+      break;
+    case COMMAND_CLASS::UNMAPPED:
+      break;
+  }
+  for (const auto& listener : monitor_listeners_)
+    listener->handleMidiCommand(event);
+}
+
+bool MIDIProcessor::ApplyRelative_(MIDI_Command_Event& event, CC_MODE mode,
+  const ValueTransform& transform, double timestamp) {
+  // step from the parameter's last known value; nothing is sent until
+  // Lightroom has reported that value, as the step would have no base
+  double current;
+  if (!parameter_mirror_ || !parameter_mirror_->Get(event.command_id, current))
+    return false;
+  auto steps = 0;
+  switch (mode) {
+    case CC_MODE::TWOS_COMPLEMENT:
+      steps = event.value < 64 ? event.value : event.value - 128;
+      break;
+    case CC_MODE::SIGN_MAGNITUDE:
+      steps = (event.value & 0x40) ? -(event.value & 0x3F) : event.value;
+      break;
+    case CC_MODE::BINARY_OFFSET:
+      steps = event.value - 64;
+      break;
+    case CC_MODE::ABSOLUTE:
+      break;
+  }
+  // ticks coming faster than kFastTick apart are scaled up, so a quick spin
+  // covers the range while a slow turn keeps fine control
+  auto& last_tick = last_tick_[event.message];
+  const auto interval = timestamp - last_tick;
+  last_tick = timestamp;
+  auto acceleration = 1.0;
+  if (interval > 0.0 && interval < kFastTick)
+    acceleration = std::min(kFastTick / interval, kMaxAcceleration);
+  // steps cover the transform's range, inverted if it is; the curve has no
+  // meaning without an absolute position
+  const auto low = std::min(transform.min, transform.max);
+  const auto high = std::max(transform.min, transform.max);
+  if (transform.invert)
+    steps = -steps;
+  current += steps * acceleration * (high - low) / kStepsPerRange;
+  current = std::min(std::max(current, low), high);
+  parameter_mirror_->Update(event.command_id, current);
+  event.value = static_cast<int>(std::lround(current * 16383.0));
+  event.max_value = 16383;
+  event.lr_value = current;
+  return true;
+}
+
+void MIDIProcessor::bankSelected(const MappingTable& previous,
+  const MappingTable& next) {
+  if (!midi_sender_ || !parameter_mirror_)
+    return;
+  for (size_t id = 0; id < next.commandCount(); ++id) {
+    const auto command_id = static_cast<unsigned short>(id);
+    for (const auto& message : next.getMessagesForCommand(command_id)) {
+      const auto* mapped = next.findCommand(message);
+      if (mapped->command_class != COMMAND_CLASS::LR_PARAMETER)
+        break;
+      const auto* was = previous.findCommand(message);
+      double value;
+      if ((!was || was->command_id != command_id) &&
+        parameter_mirror_->Get(command_id, value))
+        midi_sender_->sendValue(message, next.midiValue(message, value));
     }
   }
 }
 
-void MIDIProcessor::addMIDICommandListener(MIDICommandListener* listener) {
-  for (const auto& current_listener : listeners_)
+void MIDIProcessor::DispatchEvent_(const MIDI_Event& event, std::uint32_t now_ms) {
+  const size_t device = event.device;
+  const auto device_id = inputs_[device].device_id.load(std::memory_order_relaxed);
+  const unsigned short int channel = event.channel; // 1-based
+  if (event.status == 0xB0) {
+    const unsigned short int control = event.data1;
+    const unsigned short int value = event.data2;
+    if (nrpn_filter_.ProcessMidi(device, channel, control, value, now_ms)) { //true if nrpn piece
+      if (nrpn_filter_.IsReady(device, channel)) //send when finished
+        SendNRPN_(device, channel);
+    }
+    else if (cc14_filter_.ProcessMidi(device, channel, control, value, now_ms)) {
+      if (cc14_filter_.IsReady(device, channel)) { //MSB/LSB pair complete
+        Publish_({channel, cc14_filter_.GetControl(device, channel), MIDI_MSG_TYPE::CC,
+          device_id},
+          cc14_filter_.GetValue(device, channel), 16383, event.timestamp);
+        cc14_filter_.Clear(device, channel);
+      }
+    }
+    else //regular message
+      Publish_({channel, control, MIDI_MSG_TYPE::CC, device_id}, value, 127,
+        event.timestamp);
+  }
+  else if (event.status == 0x90)
+    Publish_({channel, event.data1, MIDI_MSG_TYPE::NOTE, device_id}, 127, 127,
+      event.timestamp);
+  else if (event.status == 0xE0) // LSB first
+    Publish_({channel, 0, MIDI_MSG_TYPE::PITCHBEND, device_id},
+      (event.data2 << 7) | event.data1, 16383, event.timestamp);
+  else if (event.status == 0xD0)
+    Publish_({channel, 0, MIDI_MSG_TYPE::CHANNEL_PRESSURE, device_id}, event.data1,
+      127, event.timestamp);
+  else if (event.status == 0xA0)
+    Publish_({channel, event.data1, MIDI_MSG_TYPE::KEY_PRESSURE, device_id},
+      event.data2, 127, event.timestamp);
+}
+
+void MIDIProcessor::addMIDICommandListener(MIDICommandListener* listener,
+  MIDI_SUBSCRIPTION subscription) {
+  std::lock_guard<decltype(dispatch_mutex_)> lock(dispatch_mutex_);
+  auto& listeners = subscription == MIDI_SUBSCRIPTION::LR_PARAMETER ?
+    parameter_listeners_ : subscription == MIDI_SUBSCRIPTION::PROFILE_NAVIGATION ?
+    profile_listeners_ : monitor_listeners_;
+  for (const auto& current_listener : listeners)
     if (current_listener == listener)
       return; //don't add duplicates
-  listeners_.push_back(listener);
+  listeners.push_back(listener);
+}
+
+std::vector<MIDIProcessor::QueueStatistics> MIDIProcessor::GetQueueStatistics() const {
+  // atomics only, so the dispatch thread and the driver callbacks never wait
+  // for this; a device closing meanwhile may still be listed
+  std::vector<QueueStatistics> statistics;
+  for (const auto& slot : inputs_)
+    if (slot.input.load(std::memory_order_acquire))
+      statistics.push_back({slot.device_id.load(std::memory_order_relaxed),
+        slot.queue.size(),
+        slot.max_depth.load(std::memory_order_relaxed),
+        slot.overflows.load(std::memory_order_relaxed),
+        slot.rejected.load(std::memory_order_relaxed)});
+  return statistics;
+}
+
+void MIDIProcessor::SetNRPNTimeout(int milliseconds) noexcept {
+  nrpn_timeout_ms_.store(milliseconds > 0 ? milliseconds : 1, std::memory_order_relaxed);
+  juce::Thread::notify(); // pick up the new timeout
+}
+
+void MIDIProcessor::SetPickupEnabled(bool enabled) noexcept {
+  pickup_enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void MIDIProcessor::SetInputFilter(const juce::String& device_name,
+  const MIDI_InputFilter& filter) {
+  std::lock_guard<decltype(dispatch_mutex_)> lock(dispatch_mutex_);
+  input_filters_[device_name] = filter;
 }
 
 void MIDIProcessor::RescanDevices() {
-  for (const auto& dev : devices_)
-    dev->stop();
-  devices_.clear();
+  CloseDevices_();
+  UpdateDevices_(juce::MidiInput::getDevices());
+}
+
+void MIDIProcessor::timerCallback() {
+  const auto device_names = juce::MidiInput::getDevices();
+  if (device_names != device_names_)
+    UpdateDevices_(device_names);
+}
+
+void MIDIProcessor::ResetSlot_(size_t id) {
+  // caller holds dispatch_mutex_ and has stopped the device
+  auto& slot = inputs_[id];
+  cc14_filter_.ClearDevice(id);
+  nrpn_filter_.ClearDevice(id);
+  slot.input.store(nullptr, std::memory_order_release);
+  slot.device.reset();
+  slot.queue.clear();
+  slot.max_depth.store(0, std::memory_order_relaxed);
+  slot.overflows.store(0, std::memory_order_relaxed);
+  slot.rejected.store(0, std::memory_order_relaxed);
+}
 
-  InitDevices_();
+void MIDIProcessor::CloseDevices_() {
+  for (auto& slot : inputs_)
+    if (slot.device)
+      slot.device->stop();
+  // wait for the dispatch thread to finish with the queues before reusing them
+  std::lock_guard<decltype(dispatch_mutex_)> lock(dispatch_mutex_);
+  for (size_t id = 0; id < inputs_.size(); ++id)
+    ResetSlot_(id);
+  device_names_.clear();
 }
 
-void MIDIProcessor::InitDevices_() {
-  for (auto idx = 0; idx < juce::MidiInput::getDevices().size(); idx++) {
-    const auto dev = juce::MidiInput::openDevice(idx, this);
+void MIDIProcessor::UpdateDevices_(const juce::StringArray& device_names) {
+  // match open inputs to the device list by name; names may repeat when
+  // several identical controllers are attached
+  std::vector<bool> already_open(static_cast<size_t>(device_names.size()), false);
+  std::array<bool, kMaxInputDevices> vanished{};
+  for (size_t id = 0; id < inputs_.size(); ++id) {
+    auto& slot = inputs_[id];
+    if (!slot.device)
+      continue;
+    const auto name = slot.device->getName();
+    vanished[id] = true;
+    for (auto idx = 0; idx < device_names.size(); ++idx)
+      if (!already_open[idx] && device_names[idx] == name) {
+        already_open[idx] = true;
+        vanished[id] = false;
+        break;
+      }
+    if (vanished[id])
+      slot.device->stop();
+  }
+
+  std::lock_guard<decltype(dispatch_mutex_)> lock(dispatch_mutex_);
+  for (size_t id = 0; id < inputs_.size(); ++id)
+    if (vanished[id])
+      ResetSlot_(id);
+  // new devices take the lowest free ids, so the decoder tables stay dense
+  auto slot = inputs_.begin();
+  auto rescan = false;
+  for (auto idx = 0; idx < device_names.size(); idx++) {
+    if (already_open[idx])
+      continue;
+    const auto filter = input_filters_.find(device_names[idx]);
+    const auto settings = filter != input_filters_.end() ? filter->second :
+      MIDI_InputFilter{};
+    if (!settings.open)
+      continue;
+    while (slot != inputs_.end() && slot->device)
+      ++slot;
+    if (slot == inputs_.end())
+      break;
+    const auto twins = std::count(device_names.begin(), device_names.begin() + idx,
+      device_names[idx]);
+    const auto current = CurrentDeviceIndex(device_names[idx], static_cast<int>(twins));
+    if (current < 0) { // unplugged since the scan
+      rescan = true;
+      continue;
+    }
+    const auto dev = juce::MidiInput::openDevice(current, this);
     if (dev != nullptr) {
-      devices_.emplace_back(dev);
+      FillAcceptTable(settings, slot->accept);
+      // mappings name the device, so they follow it to whichever slot it gets.
+      // identical controllers are told apart by their order in the list
+      auto device_key = device_names[idx];
+      if (twins > 0)
+        device_key << " #" << static_cast<int>(twins + 1);
+      slot->device_id.store(command_map_ ? command_map_->InternDevice(device_key) : 0,
+        std::memory_order_relaxed);
+      slot->device.reset(dev);
+      slot->input.store(dev, std::memory_order_release);
       dev->start();
     }
   }
+  // the next timer scan sees a change if the list was already out of date
+  device_names_ = rescan ? juce::StringArray{} : device_names;
 }
\ No newline at end of file
@@ -22,39 +22,182 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDIPROCESSOR_H_INCLUDED
 #define MIDIPROCESSOR_H_INCLUDED
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "CC14Filter.h"
+#include "CommandMap.h"
+#include "MIDISender.h"
 #include "NrpnMessage.h"
+#include "ParameterMirror.h"
+#include "Utilities/GSL.h"
+#include "Utilities/Utilities.h"
+
+// an incoming message with its mapping already resolved
+struct MIDI_Command_Event {
+  MIDI_Message_ID message; // as mapped: device is 0 unless mapped for the device
+  unsigned short device; // CommandMap::InternDevice id of the sending device
+  int value; // notes arrive at full scale
+  int max_value; // 16383 for NRPN, 14-bit CC and pitch bend, else 127
+  double lr_value; // value for Lightroom, 0-1, after the mapping's transform
+  const std::string* command; // nullptr if the message isn't mapped
+  unsigned short command_id; // CommandMap::kNoCommand if not mapped
+  COMMAND_CLASS command_class;
+  // commands sent after command, valid only during the call
+  gsl::span<const std::string* const> macro;
+  // -1, or the value the control must reach to pick up the parameter; the
+  // event then goes only to MONITOR listeners
+  int pickup_value;
+};
+
+// what a listener is sent
+enum class MIDI_SUBSCRIPTION {
+  LR_PARAMETER, // messages mapped to Lightroom commands
+  PROFILE_NAVIGATION, // messages mapped to Previous/Next Profile
+  MONITOR // every message, mapped or not
+};
 
 class MIDICommandListener {
 public:
-  virtual void handleMidiCC(int midi_channel, int controller, int value) = 0;
-  virtual void handleMidiNote(int midi_channel, int note) = 0;
+  virtual void handleMidiCommand(const MIDI_Command_Event& event) = 0;
 
   virtual ~MIDICommandListener() {};
 };
 
-class MIDIProcessor final: private juce::MidiInputCallback {
+// compact decoded form of an incoming message, handed from the MIDI driver
+// callback to the dispatch thread
+struct MIDI_Event {
+  double timestamp; // seconds, as stamped by juce::MidiInput
+  unsigned char device; // dense id assigned when the input was opened
+  unsigned char status; // status byte with channel stripped, e.g. 0xB0
+  unsigned char channel; // 1-based
+  unsigned char data1;
+  unsigned char data2; // 0 for two-byte messages
+};
+
+// which MIDI IN devices are opened and which of their messages are kept
+struct MIDI_InputFilter {
+  bool open{true};
+  bool notes{true};
+  bool controllers{true};
+  bool pitch_bend{false}; // opted into per device, as pressure is
+  bool pressure{false}; // channel and key pressure, which stream constantly
+  std::uint16_t channels{0xFFFFu}; // bit n set: accept channel n + 1
+};
+
+class MIDIProcessor final: private juce::MidiInputCallback, private juce::Thread,
+  private juce::Timer, private BankListener {
 public:
   MIDIProcessor() noexcept;
   virtual ~MIDIProcessor();
-  void Init(void);
+  void Init(std::shared_ptr<CommandMap>& command_map,
+    std::shared_ptr<ParameterMirror>& parameter_mirror,
+    std::shared_ptr<MIDISender>& midi_sender);
 
-  void addMIDICommandListener(MIDICommandListener*);
+  // each message is looked up in the command map once and sent only to the
+  // listeners subscribed to its class
+  void addMIDICommandListener(MIDICommandListener*, MIDI_SUBSCRIPTION subscription);
 
-  // re-enumerates MIDI IN devices
+  // closes and reopens all MIDI IN devices; devices plugged in or removed
+  // while running are picked up without this
   void RescanDevices();
 
+  struct QueueStatistics {
+    unsigned short device_id; // see CommandMap::getDeviceName
+    size_t depth; // events waiting for dispatch
+    size_t max_depth; // high-water mark since the device was opened
+    size_t overflows; // events dropped because the queue was full
+    size_t rejected; // messages discarded by the device's input filter
+  };
+  // snapshot of the per-device input queues from atomics only, safe to call
+  // from any thread without holding up MIDI input
+  std::vector<QueueStatistics> GetQueueStatistics() const;
+
+  // how long an NRPN value MSB, or a 14-bit CC MSB, waits for its LSB before
+  // being sent alone
+  void SetNRPNTimeout(int milliseconds) noexcept;
+  static constexpr int kDefaultNRPNTimeout = 20; // milliseconds
+
+  // whether absolute controls must pick up a parameter's value before
+  // moving it
+  void SetPickupEnabled(bool enabled) noexcept;
+
+  // filter for the named device, takes effect when devices are next opened;
+  // devices without a filter are opened and pass notes and controllers
+  void SetInputFilter(const juce::String& device_name,
+    const MIDI_InputFilter& filter);
+
 private:
+  static constexpr size_t kMaxInputDevices = NRPN_Filter::kMaxDevices;
+  static constexpr size_t kQueueSize = 1024;
+
+  // the slot index is the device's dense id, reused once the device closes
+  struct InputSlot {
+    // read by the driver callback to find its queue, owned via device
+    std::atomic<juce::MidiInput*> input{nullptr};
+    std::unique_ptr<juce::MidiInput> device;
+    RSJ::spsc_ring<MIDI_Event, kQueueSize> queue;
+    std::array<bool, 256> accept{}; // by status byte, set before input
+    // CommandMap::InternDevice id, set before input
+    std::atomic<unsigned short> device_id{0};
+    std::atomic<size_t> max_depth{0};
+    std::atomic<size_t> overflows{0};
+    std::atomic<size_t> rejected{0};
+  };
+
   // overridden from MidiInputCallback
   void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage&) override;
+  // Thread interface, drains the input queues and calls the listeners
+  virtual void run() override;
+  // Timer interface, watches for devices being plugged in or removed
+  virtual void timerCallback() override;
 
-  void InitDevices_();
+  void DispatchEvent_(const MIDI_Event& event, std::uint32_t now_ms);
+  // returns how long the dispatch thread may sleep, -1 for until notified
+  int DispatchPending_();
+  // dispatch thread only
+  bool AnyQueued_() const noexcept;
+  void SendNRPN_(size_t device, unsigned short int channel);
+  // message.device is the sending device
+  void Publish_(MIDI_Message_ID message, int value, int max_value,
+    double timestamp);
+  // turns an encoder step into an absolute value, false if it can't be placed
+  bool ApplyRelative_(MIDI_Command_Event& event, CC_MODE mode,
+    const ValueTransform& transform, double timestamp);
+  // BankListener interface, sends the mirrored value of each control whose
+  // command differs in the newly selected bank, so feedback follows the
+  // switch without Lightroom
+  virtual void bankSelected(const MappingTable& previous,
+    const MappingTable& next) override;
+  // opens new devices and closes vanished ones, leaving the rest running
+  void UpdateDevices_(const juce::StringArray& device_names);
+  void ResetSlot_(size_t id);
+  void CloseDevices_();
 
+  CC14_Filter cc14_filter_;
   NRPN_Filter nrpn_filter_;
-  std::vector<std::unique_ptr<juce::MidiInput>> devices_;
-  std::vector<MIDICommandListener *> listeners_;
+  std::array<InputSlot, kMaxInputDevices> inputs_;
+  std::atomic<int> nrpn_timeout_ms_;
+  std::atomic<bool> pickup_enabled_{true};
+  std::atomic<bool> sleeping_{false}; // the dispatch thread waits to be notified
+  std::map<juce::String, MIDI_InputFilter> input_filters_;
+  juce::StringArray device_names_; // as of the last update, message thread only
+  mutable std::mutex dispatch_mutex_; // held while draining or changing devices
+  std::shared_ptr<CommandMap> command_map_;
+  std::shared_ptr<ParameterMirror> parameter_mirror_;
+  std::shared_ptr<MIDISender> midi_sender_;
+  std::unordered_map<MIDI_Message_ID, double> last_tick_; // relative CCs
+  // the macro of the message being dispatched
+  std::array<const std::string*, MappingTable::kMaxMacroCommands> macro_commands_;
+  std::vector<MIDICommandListener *> parameter_listeners_;
+  std::vector<MIDICommandListener *> profile_listeners_;
+  std::vector<MIDICommandListener *> monitor_listeners_;
 };
 
 #endif  // MIDIPROCESSOR_H_INCLUDED
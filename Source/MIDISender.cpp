@@ -19,44 +19,163 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "MIDISender.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+  constexpr int kDeviceScanInterval = 1000;
+
+  // index of the output named name in the driver's list as it is now,
+  // counting from 0 among outputs of that name; -1 if it has gone. the list
+  // may have changed since it was scanned, and outputs are opened by index
+  int CurrentDeviceIndex(const juce::String& name, int twin) {
+    const auto devices = juce::MidiOutput::getDevices();
+    for (auto idx = 0; idx < devices.size(); ++idx)
+      if (devices[idx] == name && twin-- == 0)
+        return idx;
+    return -1;
+  }
+}
 
 MIDISender::MIDISender() noexcept {}
 
-MIDISender::~MIDISender() {}
+MIDISender::~MIDISender() {
+  juce::Timer::stopTimer();
+}
 
 void MIDISender::Init(void) {
-  InitDevices_();
+  UpdateDevices_(juce::MidiOutput::getDevices());
+  juce::Timer::startTimer(kDeviceScanInterval);
 }
 
-void MIDISender::sendCC(int midi_channel, int controller, int value) const {
-  if (controller < 128) { // regular message
-    for (const auto& dev : output_devices_)
-      dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, controller,
-        value));
+void MIDISender::sendCC(int midi_channel, int controller, int value) {
+  Send_(0xB0, midi_channel, controller, value);
+}
+
+void MIDISender::sendPitchBend(int midi_channel, int value) {
+  Send_(0xE0, midi_channel, 0, value);
+}
+
+void MIDISender::sendChannelPressure(int midi_channel, int value) {
+  Send_(0xD0, midi_channel, 0, value);
+}
+
+void MIDISender::sendKeyPressure(int midi_channel, int note, int value) {
+  Send_(0xA0, midi_channel, note, value);
+}
+
+void MIDISender::sendValue(const MIDI_Message_ID& message, int value) {
+  switch (message.msg_type) {
+    case MIDI_MSG_TYPE::NOTE:
+    case MIDI_MSG_TYPE::CC:
+      sendCC(message.channel, message.controller, value);
+      break;
+    case MIDI_MSG_TYPE::PITCHBEND:
+      sendPitchBend(message.channel, value);
+      break;
+    case MIDI_MSG_TYPE::CHANNEL_PRESSURE:
+      sendChannelPressure(message.channel, value);
+      break;
+    case MIDI_MSG_TYPE::KEY_PRESSURE:
+      sendKeyPressure(message.channel, message.pitch, value);
+      break;
   }
-  else { // NRPN
-    const auto parameterLSB = controller & 0x7f;
-    const auto parameterMSB = (controller >> 7) & 0x7F;
-    const auto valueLSB = value & 0x7f;
-    const auto valueMSB = (value >> 7) & 0x7F;
-    for (const auto& dev : output_devices_) {
-      dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 99, parameterMSB));
-      dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 98, parameterLSB));
-      dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 6, valueMSB));
-      dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 38, valueLSB));
-    }
+}
+
+void MIDISender::Send_(int status, int midi_channel, int number, int value) {
+  std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+  last_values_[std::make_tuple(status, midi_channel, number)] = value;
+  for (const auto& dev : output_devices_)
+    SendMessage_(*dev, status, midi_channel, number, value);
+}
+
+void MIDISender::SendMessage_(juce::MidiOutput& device, int status,
+  int midi_channel, int number, int value) {
+  switch (status) {
+    case 0xB0:
+      if (number < 128) { // regular message
+        device.sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, number,
+          value));
+      }
+      else { // NRPN
+        const auto parameterLSB = number & 0x7f;
+        const auto parameterMSB = (number >> 7) & 0x7F;
+        const auto valueLSB = value & 0x7f;
+        const auto valueMSB = (value >> 7) & 0x7F;
+        device.sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 99, parameterMSB));
+        device.sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 98, parameterLSB));
+        device.sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 6, valueMSB));
+        device.sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 38, valueLSB));
+      }
+      break;
+    case 0xE0:
+      device.sendMessageNow(juce::MidiMessage::pitchWheel(midi_channel, value));
+      break;
+    case 0xD0:
+      device.sendMessageNow(juce::MidiMessage::channelPressureChange(midi_channel,
+        value));
+      break;
+    case 0xA0:
+      device.sendMessageNow(juce::MidiMessage::aftertouchChange(midi_channel, number,
+        value));
+      break;
   }
 }
 
 void MIDISender::RescanDevices() {
-  output_devices_.clear();
-  InitDevices_();
+  {
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    output_devices_.clear();
+    device_names_.clear();
+  }
+  UpdateDevices_(juce::MidiOutput::getDevices());
+}
+
+void MIDISender::timerCallback() {
+  const auto device_names = juce::MidiOutput::getDevices();
+  if (device_names != device_names_)
+    UpdateDevices_(device_names);
 }
 
-void MIDISender::InitDevices_() {
-  for (auto idx = 0; idx < juce::MidiOutput::getDevices().size(); idx++) {
-    auto dev = juce::MidiOutput::openDevice(idx);
-    if (dev != nullptr)
-      output_devices_.emplace_back(dev);
+void MIDISender::UpdateDevices_(const juce::StringArray& device_names) {
+  std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+  // match open outputs to the device list by name; names may repeat when
+  // several identical controllers are attached
+  std::vector<bool> already_open(static_cast<size_t>(device_names.size()), false);
+  auto dev = output_devices_.begin();
+  while (dev != output_devices_.end()) {
+    auto found = false;
+    for (auto idx = 0; idx < device_names.size(); ++idx)
+      if (!already_open[idx] && device_names[idx] == (*dev)->getName()) {
+        already_open[idx] = true;
+        found = true;
+        break;
+      }
+    if (found)
+      ++dev;
+    else
+      dev = output_devices_.erase(dev);
+  }
+  auto rescan = false;
+  for (auto idx = 0; idx < device_names.size(); idx++) {
+    if (already_open[idx])
+      continue;
+    const auto twins = std::count(device_names.begin(), device_names.begin() + idx,
+      device_names[idx]);
+    const auto current = CurrentDeviceIndex(device_names[idx], static_cast<int>(twins));
+    if (current < 0) { // unplugged since the scan
+      rescan = true;
+      continue;
+    }
+    const auto new_dev = juce::MidiOutput::openDevice(current);
+    if (new_dev != nullptr) {
+      output_devices_.emplace_back(new_dev);
+      // bring the new device's displays and motor faders up to date
+      for (const auto& value : last_values_)
+        SendMessage_(*new_dev, std::get<0>(value.first), std::get<1>(value.first),
+          std::get<2>(value.first), value.second);
+    }
   }
+  // the next timer scan sees a change if the list was already out of date
+  device_names_ = rescan ? juce::StringArray{} : device_names;
 }
\ No newline at end of file
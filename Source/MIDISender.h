@@ -21,24 +21,50 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #ifndef MIDISENDER_H_INCLUDED
 #define MIDISENDER_H_INCLUDED
+#include <map>
 #include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "CommandMap.h"
 
-class MIDISender {
+class MIDISender final: private juce::Timer {
 public:
   MIDISender() noexcept;
   virtual ~MIDISender();
   void Init();
 
-  // sends a CC message to all output devices
-  void sendCC(int midi_channel, int controller, int value) const;
+  // sends a CC message to all output devices, NRPN for controller >= 128
+  void sendCC(int midi_channel, int controller, int value);
+  // value runs 0-16383
+  void sendPitchBend(int midi_channel, int value);
+  void sendChannelPressure(int midi_channel, int value);
+  void sendKeyPressure(int midi_channel, int note, int value);
+  // sends a value, 0 to message.maxValue(), as the kind of message it is
+  // for; notes are answered with a CC of the same number
+  void sendValue(const MIDI_Message_ID& message, int value);
 
-  // re-enumerates MIDI OUT devices
+  // closes and reopens all MIDI OUT devices; devices plugged in or removed
+  // while running are picked up without this
   void RescanDevices();
 
 private:
-  void InitDevices_();
+  // Timer interface, watches for devices being plugged in or removed
+  virtual void timerCallback() override;
+  // status is the message kind with the channel stripped, e.g. 0xB0
+  void Send_(int status, int midi_channel, int number, int value);
+  static void SendMessage_(juce::MidiOutput& device, int status, int midi_channel,
+    int number, int value);
+  // opens new devices and closes vanished ones, leaving the rest open; new
+  // devices are sent the last value of every control
+  void UpdateDevices_(const juce::StringArray& device_names);
+
+  // senders run on the LR_IPC_IN and MIDI threads
+  mutable std::mutex devices_mutex_;
+  // last value sent, keyed by (status, channel, controller or note)
+  std::map<std::tuple<int, int, int>, int> last_values_;
+  juce::StringArray device_names_; // as of the last update
   std::vector<std::unique_ptr<juce::MidiOutput>> output_devices_;
 };
 
@@ -32,11 +32,13 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CommandMap.h"
+#include "IOReactor.h"
 #include "LR_IPC_IN.h"
 #include "LR_IPC_OUT.h"
 #include "MainComponent.h"
 #include "MainWindow.h"
 #include "MIDISender.h"
+#include "ParameterMirror.h"
 #include "SettingsManager.h"
 #include "VersionChecker.h"
 
@@ -46,10 +48,12 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
 public:
   MIDI2LRApplication() {
     command_map_ = std::make_shared<CommandMap>();
+    parameter_mirror_ = std::make_shared<ParameterMirror>();
     profile_manager_ = std::make_shared<ProfileManager>();
     settings_manager_ = std::make_shared<SettingsManager>();
     midi_processor_ = std::make_shared<MIDIProcessor>();
     midi_sender_ = std::make_shared<MIDISender>();
+    io_reactor_ = std::make_shared<IOReactor>();
     lr_ipc_out_ = std::make_shared<LR_IPC_OUT>();
     lr_ipc_in_ = std::make_shared<LR_IPC_IN>();
   }
@@ -82,18 +86,22 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
     // be run.
 
     if (command_line != ShutDownString) {
-      midi_processor_->Init();
       midi_sender_->Init();
-      lr_ipc_out_->Init(command_map_, midi_processor_);
+      lr_ipc_out_->Init(midi_processor_, io_reactor_);
       //set the reference to the command map
       profile_manager_->Init(lr_ipc_out_, command_map_, midi_processor_);
       //initialize the IPC_In
-      lr_ipc_in_->Init(command_map_, profile_manager_, midi_sender_);
+      lr_ipc_in_->Init(command_map_, profile_manager_, midi_sender_,
+        parameter_mirror_, lr_ipc_out_, io_reactor_);
       // initialize the settings manager
-      settings_manager_->Init(lr_ipc_out_, profile_manager_);
+      settings_manager_->Init(lr_ipc_out_, profile_manager_, midi_processor_);
+      // open MIDI IN devices once their filters are loaded
+      midi_processor_->Init(command_map_, parameter_mirror_, midi_sender_);
       main_window_ = std::make_unique<MainWindow>(getApplicationName());
       main_window_->Init(command_map_, lr_ipc_in_, lr_ipc_out_, midi_processor_,
         profile_manager_, settings_manager_, midi_sender_);
+      // connect to the plugin once everything listening is in place
+      io_reactor_->Start();
       // Check for latest version
       version_checker_.Init(settings_manager_);
       version_checker_.startThread();
@@ -114,6 +122,8 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
     // Be careful that nothing happens in this method that might rely on messages
     // being sent, or any kind of window activity, because the message loop is no
     // longer running at this point.
+    if (io_reactor_)
+      io_reactor_->Stop(); // nothing calls into the rest from its thread after this
     lr_ipc_out_.reset();
     lr_ipc_in_.reset();
     command_map_.reset();
@@ -121,6 +131,8 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
     settings_manager_.reset();
     midi_processor_.reset();
     midi_sender_.reset();
+    parameter_mirror_.reset();
+    io_reactor_.reset();
     main_window_ = nullptr; // (deletes our window)
   }
 
@@ -129,8 +141,8 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
       // This is called when the application is being asked to quit: you can
       // ignore this request and let the application carry on running, or call
       // quit() to allow the application to close.
-    if (lr_ipc_in_)
-      lr_ipc_in_->PleaseStopThread();
+    if (io_reactor_)
+      io_reactor_->PleaseStopThread();
     auto default_profile =
       juce::File::getSpecialLocation(juce::File::currentExecutableFile).getSiblingFile("default.xml");
     if (command_map_)
@@ -170,6 +182,8 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
 
 private:
   std::shared_ptr<CommandMap> command_map_;
+  std::shared_ptr<IOReactor> io_reactor_;
+  std::shared_ptr<ParameterMirror> parameter_mirror_;
   std::shared_ptr<LR_IPC_IN> lr_ipc_in_;
   std::shared_ptr<LR_IPC_OUT> lr_ipc_out_;
   std::shared_ptr<MIDIProcessor> midi_processor_;
@@ -71,7 +71,7 @@ void MainContentComponent::Init(std::shared_ptr<CommandMap>& command_map,
 
   if (midi_processor) {
       // Add ourselves as a listener for MIDI commands
-    midi_processor->addMIDICommandListener(this);
+    midi_processor->addMIDICommandListener(this, MIDI_SUBSCRIPTION::MONITOR);
   }
 
   if (const auto ptr = lr_ipc_out_.lock()) {
@@ -194,19 +194,49 @@ void MainContentComponent::paint(juce::Graphics& g) {
   g.fillAll(juce::Colours::white);
 }
 
-void MainContentComponent::handleMidiCC(int midi_channel, int controller, int value) {
-    // Display the CC parameters and add/highlight row in table corresponding to the CC
-  last_command_ = juce::String::formatted("%d: CC%d [%d]", midi_channel, controller, value);
-  command_table_model_.addRow(midi_channel, controller, true);
-  row_to_select_ = command_table_model_.getRowForMessage(midi_channel, controller, true);
-  triggerAsyncUpdate();
-}
-
-void MainContentComponent::handleMidiNote(int midi_channel, int note) {
-    // Display the Note parameters and add/highlight row in table corresponding to the Note
-  last_command_ = juce::String::formatted("%d: Note [%d]", midi_channel, note);
-  command_table_model_.addRow(midi_channel, note, false);
-  row_to_select_ = command_table_model_.getRowForMessage(midi_channel, note, false);
+void MainContentComponent::handleMidiCommand(const MIDI_Command_Event& event) {
+    // Display the message and add/highlight row in table corresponding to it
+  // the table and command map are edited on the message thread, in
+  // handleAsyncUpdate. messages are kept with the sending device, which
+  // handleAsyncUpdate drops unless learning per device
+  auto message = event.message;
+  message.device = event.device;
+  std::lock_guard<RSJ::spinlock> lock(learn_mutex_);
+  if (event.command_class == COMMAND_CLASS::BANK_SELECT) {
+    // the table shows the active bank. the bank button's release arrives
+    // after the switch and shouldn't be learned into the new bank
+    bank_selected_ = true;
+    bank_message_ = message;
+  }
+  else if (!(bank_message_ == message) && (learned_messages_.empty() ||
+    !(learned_messages_.back() == message)))
+    learned_messages_.push_back(message);
+  switch (message.msg_type) {
+    case MIDI_MSG_TYPE::NOTE:
+      last_command_ = juce::String::formatted("%d: Note [%d]", message.channel,
+        message.pitch);
+      break;
+    case MIDI_MSG_TYPE::CC:
+      last_command_ = juce::String::formatted(event.max_value == 16383 ?
+        "%d: CC%d [%d/16383]" : "%d: CC%d [%d]", message.channel,
+        message.controller, event.value);
+      break;
+    case MIDI_MSG_TYPE::PITCHBEND:
+      last_command_ = juce::String::formatted("%d: Pitch Bend [%d/16383]",
+        message.channel, event.value);
+      break;
+    case MIDI_MSG_TYPE::CHANNEL_PRESSURE:
+      last_command_ = juce::String::formatted("%d: Channel Pressure [%d]",
+        message.channel, event.value);
+      break;
+    case MIDI_MSG_TYPE::KEY_PRESSURE:
+      last_command_ = juce::String::formatted("%d: Key Pressure %d [%d]",
+        message.channel, message.pitch, event.value);
+      break;
+  }
+  awaiting_pickup_ = event.pickup_value >= 0;
+  if (awaiting_pickup_)
+    last_command_ += juce::String::formatted(" pick up at %d", event.pickup_value);
   triggerAsyncUpdate();
 }
 
@@ -220,6 +250,14 @@ void MainContentComponent::disconnected() {
   connection_label_.setColour(juce::Label::backgroundColourId, juce::Colours::red);
 }
 
+void MainContentComponent::congestionChanged(bool congested) {
+  // Lightroom is slow to read; values are merged until it catches up
+  connection_label_.setText(congested ? "Connected to LR (busy)" : "Connected to LR",
+    juce::NotificationType::dontSendNotification);
+  connection_label_.setColour(juce::Label::backgroundColourId,
+    congested ? juce::Colours::orange : Colours::greenyellow);
+}
+
 void MainContentComponent::buttonClicked(juce::Button* button) {
   if (button == &rescan_button_) {
       // Re-enumerate MIDI IN and OUT devices
@@ -313,7 +351,7 @@ void MainContentComponent::buttonClicked(juce::Button* button) {
     auto *component = new SettingsComponent{};
     component->Init(settings_manager_);
     dialog_options.content.setOwned(component);
-    dialog_options.content->setSize(400, 300);
+    dialog_options.content->setSize(400, 360);
     dialog_options.escapeKeyTriggersCloseButton = true;
     dialog_options.useNativeTitleBar = false;
     settings_dialog_.reset(dialog_options.create());
@@ -351,14 +389,41 @@ void MainContentComponent::SetLabelSettings(juce::Label& label_to_set) {
 }
 
 void MainContentComponent::handleAsyncUpdate() {
-    // Update the last command label and set its colour to green
-  command_label_.setText(last_command_, juce::NotificationType::dontSendNotification);
-  command_label_.setColour(juce::Label::backgroundColourId, juce::Colours::greenyellow);
+  std::vector<MIDI_Message_ID> messages;
+  juce::String last_command;
+  auto bank_selected = false;
+  auto awaiting_pickup = false;
+  {
+    std::lock_guard<RSJ::spinlock> lock(learn_mutex_);
+    messages.swap(learned_messages_);
+    last_command = last_command_;
+    awaiting_pickup = awaiting_pickup_;
+    std::swap(bank_selected, bank_selected_);
+  }
+  if (bank_selected)
+    command_table_model_.buildFromMap();
+  else if (messages.empty())
+    return;
+  const auto per_device = settings_manager_ && settings_manager_->getLearnPerDevice();
+  auto row_to_select = -1;
+  for (auto message : messages) {
+    // an existing mapping for the device is selected either way
+    if (!per_device && !(command_map_ && command_map_->messageExistsInMap(message)))
+      message.device = 0;
+    command_table_model_.addRow(message);
+    row_to_select = command_table_model_.getRowForMessage(message);
+  }
+
+    // Update the last command label and set its colour to green, or orange
+    // while the control has yet to pick up its parameter
+  command_label_.setText(last_command, juce::NotificationType::dontSendNotification);
+  command_label_.setColour(juce::Label::backgroundColourId, awaiting_pickup ?
+    juce::Colours::orange : juce::Colours::greenyellow);
   startTimer(1000);
 
   // Update the command table to add and/or select row corresponding to midi command
   command_table_.updateContent();
-  command_table_.selectRow(row_to_select_);
+  command_table_.selectRow(row_to_select);
 }
 
 void MainContentComponent::timerCallback() {
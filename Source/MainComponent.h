@@ -27,6 +27,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MAINCOMPONENT_H_INCLUDED
 
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CommandMap.h"
 #include "CommandTable.h"
@@ -37,6 +39,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "ProfileManager.h"
 #include "ResizableLayout.h"
 #include "SettingsManager.h"
+#include "Utilities/Utilities.h"
 
 class MainContentComponent final:
   public juce::Component,
@@ -59,12 +62,12 @@ class MainContentComponent final:
     std::shared_ptr<MIDISender>& midi_sender);
 
   // MIDICommandListener interface
-  virtual void handleMidiCC(int midi_channel, int controller, int value) override;
-  virtual void handleMidiNote(int midi_channel, int note) override;
+  virtual void handleMidiCommand(const MIDI_Command_Event& event) override;
 
   // LRConnectionListener interface
   virtual void connected() override;
   virtual void disconnected() override;
+  virtual void congestionChanged(bool congested) override;
 
   // ProfileChangeListener interface
   virtual void profileChanged(juce::XmlElement* elem, const juce::String& file_name) override;
@@ -86,7 +89,6 @@ class MainContentComponent final:
   CommandTable command_table_{"Table", nullptr};
   CommandTableModel command_table_model_{};
   juce::DropShadowEffect title_shadow_;
-  int row_to_select_;
   juce::Label command_label_{"Command", ""};
   juce::Label connection_label_{"Connection", "Not connected to LR"};
   juce::Label current_status_{"CurrentStatus", "no extra info"};
@@ -101,6 +103,11 @@ class MainContentComponent final:
   std::shared_ptr<SettingsManager> settings_manager_{nullptr};
   std::unique_ptr<DialogWindow> settings_dialog_;
   juce::String last_command_;
+  std::vector<MIDI_Message_ID> learned_messages_; // awaiting a table row
+  MIDI_Message_ID bank_message_{0, 0, MIDI_MSG_TYPE::NOTE}; // last bank button
+  bool bank_selected_{false}; // the table needs the new bank's rows
+  bool awaiting_pickup_{false}; // last_command_ wasn't sent, see pickup_value
+  RSJ::spinlock learn_mutex_; // guards the learn state above
   juce::TextButton load_button_{"Load"};
   juce::TextButton remove_row_button_{"Remove selected row"};
   juce::TextButton rescan_button_{"Rescan MIDI devices"};
@@ -21,18 +21,39 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "NrpnMessage.h"
 
 bool NRPN_Message::ProcessMidi(unsigned short int control,
-  unsigned short int value) noexcept(ndebug) {
+  unsigned short int value, std::uint32_t time_ms) noexcept(ndebug) {
   auto ret_val = true;
   switch (control) {
     case 6u:
-      if (ready_ >= 0b11u)
+      if (IsSelected_()) {
         SetValueMSB(value);
+        if (ready_ & kMSBOnly)
+          CompleteFromMSB_();
+        else
+          msb_time_ms_ = time_ms;
+      }
       else
         ret_val = false;
       break;
     case 38u:
-      if (ready_ >= 0b11u)
+      if (IsSelected_()) {
+        ready_ &= ~kMSBOnly;
+        ready_ |= 0b100u; // a lone LSB keeps the previous MSB
         SetValueLSB(value);
+      }
+      else
+        ret_val = false;
+      break;
+    case 96u: // data increment
+    case 97u: // data decrement
+      if (IsSelected_()) {
+        const int step = (value ? value : 1) << 7;
+        auto new_value = GetValue() + (control == 96u ? step : -step);
+        new_value = new_value < 0 ? 0 : (new_value > 0x3FFF ? 0x3FFF : new_value);
+        value_msb_ = static_cast<unsigned char>(new_value >> 7);
+        value_lsb_ = static_cast<unsigned char>(new_value & 0x7F);
+        ready_ |= 0b1100u;
+      }
       else
         ret_val = false;
       break;
@@ -42,13 +63,24 @@ bool NRPN_Message::ProcessMidi(unsigned short int control,
     case 99u:
       SetControlMSB(value);
       break;
+    case 100u: // RPN select: the data entry that follows isn't for this NRPN
+    case 101u:
+      Reset();
+      ret_val = false;
+      break;
     default: //not an expected nrpn control #, handle as typical midi message
       ret_val = false;
   }
+  if (IsSelected_() && control_msb_ == 0x7Fu && control_lsb_ == 0x7Fu)
+    Reset(); // null parameter
   return ret_val;
 }
 
 void NRPN_Message::Clear() noexcept {
+  ready_ &= ~kReadyMask | 0b11u;
+}
+
+void NRPN_Message::Reset() noexcept {
   ready_ = 0u;
   control_msb_ = 0u;
   control_lsb_ = 0u;
@@ -56,26 +88,41 @@ void NRPN_Message::Clear() noexcept {
   value_lsb_ = 0u;
 }
 
+bool NRPN_Message::ExpireMSB(std::uint32_t now_ms, std::uint32_t timeout_ms) noexcept {
+  if (!IsPending() || now_ms - msb_time_ms_ < timeout_ms)
+    return false;
+  ready_ |= kMSBOnly;
+  CompleteFromMSB_();
+  return true;
+}
+
+void NRPN_Message::CompleteFromMSB_() noexcept {
+  // replicate the MSB into the low bits so 7-bit senders still reach 16383
+  value_lsb_ = value_msb_;
+  ready_ |= 0b1000u;
+}
+
 void NRPN_Message::SetControlMSB(unsigned short int val) noexcept(ndebug) {
   assert(val <= 0x7Fu);
-  control_msb_ = val & 0x7Fu;
-  ready_ |= 0b1u;
+  control_msb_ = static_cast<unsigned char>(val & 0x7Fu);
+  // new selection, drop any partial value
+  ready_ = (ready_ & (0b10u | kMSBOnly)) | 0b1u;
 }
 
 void NRPN_Message::SetControlLSB(unsigned short int val) noexcept(ndebug) {
   assert(val <= 0x7Fu);
-  control_lsb_ = val & 0x7Fu;
-  ready_ |= 0b10u;
+  control_lsb_ = static_cast<unsigned char>(val & 0x7Fu);
+  ready_ = (ready_ & (0b1u | kMSBOnly)) | 0b10u;
 }
 
 void NRPN_Message::SetValueMSB(unsigned short int val) noexcept(ndebug) {
   assert(val <= 0x7Fu);
-  value_msb_ = val & 0x7Fu;
+  value_msb_ = static_cast<unsigned char>(val & 0x7Fu);
   ready_ |= 0b100u;
 }
 
 void NRPN_Message::SetValueLSB(unsigned short int val) noexcept(ndebug) {
   assert(val <= 0x7Fu);
-  value_lsb_ = val & 0x7Fu;
+  value_lsb_ = static_cast<unsigned char>(val & 0x7Fu);
   ready_ |= 0b1000u;
 }
\ No newline at end of file
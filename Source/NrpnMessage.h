@@ -21,31 +21,49 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include "Utilities/Utilities.h"
 
 class NRPN_Message {
-  // This is a simplified NRPN message class, and assumes that all NRPN messages
-  // have 4 messages, though the NRPN standard allows ommission of the 4th
-  // message. If the 4th message is dropped, this class silently consumes the
-  // message without emitting anything.
+  // NRPN assembly for one channel. The parameter selected by CC 99/98 stays
+  // selected after a value is emitted (running parameter), so a controller may
+  // send the selection once and then stream values. A value completes when
+  // CC 38 (value LSB) arrives; a lone CC 38 reuses the previous MSB. CC 96/97
+  // (data increment/decrement) step the current value by one 7-bit step per
+  // count in their data byte. A CC 6 (value MSB) whose LSB never shows up is
+  // completed by ExpireMSB after a timeout, and from then on that channel's
+  // MSBs are emitted at once, until an LSB is seen again. Selecting the null
+  // parameter (127/127) or an RPN (CC 101/100) deselects.
 public:
   NRPN_Message() noexcept {};
   ~NRPN_Message() {};
 
-  bool ProcessMidi(unsigned short int control, unsigned short int value)
-    noexcept(ndebug);
+  // returns true if the message was consumed as part of an NRPN
+  bool ProcessMidi(unsigned short int control, unsigned short int value,
+    std::uint32_t time_ms) noexcept(ndebug);
+  // call after emitting a ready value; keeps the parameter selected
   void Clear() noexcept;
+  // forget the parameter selection as well
+  void Reset() noexcept;
+  // completes a pending MSB-only value once timeout_ms has passed. returns
+  // true if the value became ready
+  bool ExpireMSB(std::uint32_t now_ms, std::uint32_t timeout_ms) noexcept;
   void SetControlLSB(unsigned short int val) noexcept(ndebug);
   void SetControlMSB(unsigned short int val) noexcept(ndebug);
   void SetValueLSB(unsigned short int val) noexcept(ndebug);
   void SetValueMSB(unsigned short int val) noexcept(ndebug);
 
   inline bool IsInProcess() const noexcept {
-    return ready_ != 0u;
+    return (ready_ & kReadyMask) != 0u;
   };
 
   inline bool IsReady() const noexcept {
-    return ready_ == 0b1111u;
+    return (ready_ & kReadyMask) == kReadyMask;
+  };
+
+  // value MSB received, waiting for its LSB
+  inline bool IsPending() const noexcept {
+    return (ready_ & kReadyMask) == 0b0111u;
   };
 
   inline unsigned short int GetValue() const noexcept {
@@ -57,74 +75,122 @@ class NRPN_Message {
   };
 
 private:
+  static constexpr unsigned char kReadyMask = 0b1111u;
+  static constexpr unsigned char kMSBOnly = 0b10000u; // sender omits LSBs
+
+  inline bool IsSelected_() const noexcept {
+    return (ready_ & 0b11u) == 0b11u;
+  };
+  void CompleteFromMSB_() noexcept;
+
+  std::uint32_t msb_time_ms_{0u}; // when the pending MSB arrived
+  // 7-bit fields kept in bytes so a full device x channel table stays small
   unsigned char ready_{0u};
-  unsigned short int control_msb_{0u};
-  unsigned short int control_lsb_{0u};
-  unsigned short int value_msb_{0u};
-  unsigned short int value_lsb_{0u};
+  unsigned char control_msb_{0u};
+  unsigned char control_lsb_{0u};
+  unsigned char value_msb_{0u};
+  unsigned char value_lsb_{0u};
 };
 
 class NRPN_Filter {
+  // Keeps one NRPN assembly state per (device, channel), so controllers on the
+  // same channel can't interleave each other's 99/98/6/38 sequences. device is
+  // the dense id MIDIProcessor assigns when opening an input.
 public:
+  static constexpr size_t kMaxDevices = 32;
+
   NRPN_Filter() noexcept {};
   ~NRPN_Filter() {};
-  inline bool ProcessMidi(unsigned short int channel,
-    unsigned short int control, unsigned short int value) noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].ProcessMidi(control, value);
+  inline bool ProcessMidi(size_t device, unsigned short int channel,
+    unsigned short int control, unsigned short int value, std::uint32_t time_ms)
+    noexcept(ndebug) {
+    auto& message = nrpn_messages_[Index_(device, channel)];
+    const auto was_pending = message.IsPending();
+    const auto ret_val = message.ProcessMidi(control, value, time_ms);
+    pending_ += message.IsPending() - was_pending;
+    return ret_val;
   };
 
-  inline void Clear(unsigned short int channel) noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].Clear();
+  inline void Clear(size_t device, unsigned short int channel) noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].Clear();
   };
 
-  inline void SetControlLSB(unsigned short int channel, unsigned short int val)
-    noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].SetControlLSB(val);
+  // drops any half-assembled messages from a device that went away
+  inline void ClearDevice(size_t device) noexcept(ndebug) {
+    for (unsigned short int channel = 1u; channel <= 16u; ++channel) {
+      auto& message = nrpn_messages_[Index_(device, channel)];
+      pending_ -= message.IsPending();
+      message.Reset();
+    }
   };
 
-  inline void SetControlMSB(unsigned short int channel, unsigned short int val)
-    noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].SetControlMSB(val);
+  // true if some channel is waiting for a value LSB
+  inline bool AnyPending() const noexcept {
+    return pending_ > 0;
   };
 
-  inline void SetValueLSB(unsigned short int channel, unsigned short int val)
-    noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].SetValueLSB(val);
+  // completes pending values older than timeout_ms, calling
+  // emit(device, channel) for each; emit is expected to Clear() the channel
+  template<typename Callback>
+  void ExpirePending(std::uint32_t now_ms, std::uint32_t timeout_ms,
+    Callback&& emit) {
+    if (pending_ <= 0)
+      return;
+    for (size_t idx = 0; idx < nrpn_messages_.size(); ++idx)
+      if (nrpn_messages_[idx].ExpireMSB(now_ms, timeout_ms)) {
+        --pending_;
+        emit(idx >> 4, static_cast<unsigned short int>((idx & 0xFu) + 1u));
+      }
   };
 
-  inline void SetValueMSB(unsigned short int channel, unsigned short int val)
-    noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].SetValueMSB(val);
+  inline void SetControlLSB(size_t device, unsigned short int channel,
+    unsigned short int val) noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].SetControlLSB(val);
   };
 
-  inline bool IsInProcess(unsigned short int channel) const noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].IsInProcess();
+  inline void SetControlMSB(size_t device, unsigned short int channel,
+    unsigned short int val) noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].SetControlMSB(val);
   };
 
-  inline bool IsReady(unsigned short int channel) const noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].IsReady();
+  inline void SetValueLSB(size_t device, unsigned short int channel,
+    unsigned short int val) noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].SetValueLSB(val);
+  };
+
+  inline void SetValueMSB(size_t device, unsigned short int channel,
+    unsigned short int val) noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].SetValueMSB(val);
   };
 
-  inline unsigned short int GetValue(unsigned short int channel) const
+  inline bool IsInProcess(size_t device, unsigned short int channel) const
     noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].GetValue();
+    return nrpn_messages_[Index_(device, channel)].IsInProcess();
   };
 
-  inline unsigned short int GetControl(unsigned short int channel) const
+  inline bool IsReady(size_t device, unsigned short int channel) const
     noexcept(ndebug) {
-    assert(channel - 1u < 16u);
-    return nrpn_messages_[(channel - 1u) & 0xF].GetControl();
+    return nrpn_messages_[Index_(device, channel)].IsReady();
+  };
+
+  inline unsigned short int GetValue(size_t device, unsigned short int channel)
+    const noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].GetValue();
+  };
+
+  inline unsigned short int GetControl(size_t device, unsigned short int channel)
+    const noexcept(ndebug) {
+    return nrpn_messages_[Index_(device, channel)].GetControl();
   };
 
 private:
-  std::array<NRPN_Message, 16> nrpn_messages_;
+  static inline size_t Index_(size_t device, unsigned short int channel)
+    noexcept(ndebug) {
+    assert(device < kMaxDevices);
+    assert(channel - 1u < 16u);
+    return ((device % kMaxDevices) << 4) | ((channel - 1u) & 0xFu);
+  };
+
+  int pending_{0};
+  std::array<NRPN_Message, kMaxDevices * 16> nrpn_messages_;
 };
\ No newline at end of file
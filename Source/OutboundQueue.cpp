@@ -0,0 +1,308 @@
+/*
+  ==============================================================================
+
+    OutboundQueue.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "OutboundQueue.h"
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include "CompactProtocol.h"
+#include "LRCommands.h"
+
+constexpr size_t OutboundQueue::kNotQueued;
+
+namespace {
+  // matches BUTTON_ON in Client.lua
+  constexpr double kButtonOn = 0.99;
+  constexpr size_t kReservedEntries = 256;
+  constexpr size_t kDefaultLimit = 256;
+  constexpr size_t kReservedText = 4096;
+  constexpr std::uint64_t kValueScale = 1000000; // six decimals, as std::to_string
+  constexpr double kMaxValue = 1e12; // keeps the scaled value in range
+
+  // writes value in fixed point without trailing zeros, e.g. "0.25"; unlike
+  // std::to_string it ignores the locale and doesn't allocate. returns the end
+  char* FormatValue(double value, char* out) noexcept {
+    if (value < 0.0) {
+      *out++ = '-';
+      value = -value;
+    }
+    if (!(value < kMaxValue)) // also catches NaN
+      value = value > 0.0 ? kMaxValue : 0.0;
+    const auto fixed = static_cast<std::uint64_t>(value * kValueScale + 0.5);
+    auto whole = fixed / kValueScale;
+    auto fraction = fixed % kValueScale;
+    char digits[20];
+    auto count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + whole % 10);
+      whole /= 10;
+    } while (whole);
+    while (count)
+      *out++ = digits[--count];
+    if (fraction) {
+      *out++ = '.';
+      auto places = 6;
+      while (fraction % 10 == 0) {
+        fraction /= 10;
+        --places;
+      }
+      for (auto place = places - 1; place >= 0; --place) {
+        out[place] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+      }
+      out += places;
+    }
+    return out;
+  }
+}
+
+OutboundQueue::OutboundQueue(): limit_{kDefaultLimit},
+  value_index_(LRCommandList::LRStringList.size(), kNotQueued),
+  reset_targets_(LRCommandList::LRStringList.size(), kNotQueued) {
+  static const std::string kReset{"Reset"};
+  prefixes_.reserve(LRCommandList::LRStringList.size());
+  for (size_t command_id = 0; command_id < LRCommandList::LRStringList.size();
+    ++command_id) {
+    const auto& command = LRCommandList::LRStringList[command_id];
+    prefixes_.push_back(command + ' ');
+    if (command.compare(0, kReset.size(), kReset) == 0) {
+      const auto target = static_cast<size_t>(
+        LRCommandList::getIndexOfCommand(command.substr(kReset.size())));
+      if (target != 0 && target < reset_targets_.size())
+        reset_targets_[command_id] = target;
+    }
+  }
+  actions_.reserve(kReservedEntries);
+  entries_.reserve(kReservedEntries);
+  text_.reserve(kReservedText);
+  indexed_.reserve(LRCommandList::LRStringList.size());
+}
+
+void OutboundQueue::Barrier_() noexcept {
+  for (const auto command_id : indexed_)
+    value_index_[command_id] = kNotQueued;
+  indexed_.clear();
+  barrier_ = entries_.size();
+}
+
+size_t OutboundQueue::AppendText_(const std::string& text) {
+  const auto offset = text_.size();
+  text_.append(text);
+  return offset;
+}
+
+void OutboundQueue::Append_(std::vector<Entry>& lane, const Entry& entry) {
+  lane.push_back(entry);
+  high_water_ = std::max(high_water_, ++size_);
+}
+
+bool OutboundQueue::MakeRoom_() {
+  if (size_ < limit_)
+    return true;
+  ++dropped_;
+  if (policy_ == QUEUE_FULL_POLICY::DROP_NEWEST)
+    return false;
+  // actions keep their order, so only a continuous value is evicted
+  for (; oldest_value_ < entries_.size(); ++oldest_value_) {
+    auto& entry = entries_[oldest_value_];
+    if (!entry.mergeable)
+      continue;
+    if (entry.command_id != kNotQueued &&
+      value_index_[entry.command_id] == oldest_value_)
+      value_index_[entry.command_id] = kNotQueued;
+    entry.mergeable = false;
+    entry.dropped = true;
+    --size_;
+    ++oldest_value_;
+    if (++evicted_ >= limit_) // don't grow while the writer is stalled
+      Compact_();
+    return true;
+  }
+  return false;
+}
+
+void OutboundQueue::Supersede_(size_t command_id) {
+  if (command_id >= value_index_.size())
+    return;
+  for (const auto id : {command_id, reset_targets_[command_id]}) {
+    if (id == kNotQueued || value_index_[id] == kNotQueued)
+      continue;
+    auto& entry = entries_[value_index_[id]];
+    value_index_[id] = kNotQueued;
+    entry.mergeable = false;
+    entry.dropped = true;
+    --size_;
+    ++merged_;
+    if (++evicted_ >= limit_)
+      Compact_();
+  }
+}
+
+void OutboundQueue::Compact_() {
+  size_t kept = 0;
+  auto barrier = barrier_;
+  for (size_t index = 0; index < entries_.size(); ++index) {
+    if (index == barrier_)
+      barrier = kept;
+    if (!entries_[index].dropped)
+      entries_[kept++] = entries_[index];
+  }
+  if (barrier_ >= entries_.size())
+    barrier = kept;
+  entries_.erase(entries_.begin() + kept, entries_.end());
+  for (const auto command_id : indexed_)
+    value_index_[command_id] = kNotQueued;
+  indexed_.clear();
+  barrier_ = barrier;
+  evicted_ = 0;
+  for (auto index = barrier_; index < entries_.size(); ++index) {
+    const auto& entry = entries_[index];
+    if (entry.mergeable && entry.command_id != kNotQueued) {
+      value_index_[entry.command_id] = index;
+      indexed_.push_back(entry.command_id);
+    }
+  }
+  oldest_value_ = 0;
+}
+
+void OutboundQueue::PushLine(const std::string& line) {
+  Append_(actions_, {kNotQueued, AppendText_(line), line.size(), 0.0, false, false,
+    false, false, Clock::now()});
+}
+
+void OutboundQueue::PushValue(const std::string& command, size_t command_id,
+  double value) {
+  const auto indexed = command_id < value_index_.size();
+  auto found = indexed ? value_index_[command_id] : kNotQueued;
+  if (!indexed) // rare: a command this version doesn't list
+    for (auto index = barrier_; index < entries_.size(); ++index) {
+      const auto& entry = entries_[index];
+      if (entry.mergeable && entry.length == command.size() &&
+        text_.compare(entry.text, entry.length, command) == 0) {
+        found = index;
+        break;
+      }
+    }
+  const auto mergeable = value <= kButtonOn;
+  if (found == kNotQueued) {
+    if (!mergeable && indexed) // a press, written in the actions lane
+      Supersede_(command_id);
+    if (!MakeRoom_())
+      return;
+    Append_(mergeable ? entries_ : actions_, {indexed ? command_id : kNotQueued,
+      indexed ? 0 : AppendText_(command), command.size(), value, true, mergeable,
+      indexed && compact_, false, Clock::now()});
+    if (indexed && mergeable) {
+      value_index_[command_id] = entries_.size() - 1;
+      indexed_.push_back(command_id);
+    }
+    return;
+  }
+  auto& entry = entries_[found];
+  entry.value = value;
+  ++merged_;
+  if (!mergeable) { // keep the press, later values queue behind it
+    entry.mergeable = false;
+    if (indexed)
+      value_index_[command_id] = kNotQueued;
+  }
+}
+
+void OutboundQueue::PushDiscreteValue(const std::string& command, double value) {
+  // ids past LRStringList aren't sent to the plugin by id
+  const auto command_id = static_cast<size_t>(LRCommandList::getIndexOfCommand(command));
+  const auto compact = compact_ && command_id != 0 && command_id < prefixes_.size();
+  Supersede_(command_id);
+  if (!MakeRoom_())
+    return;
+  Append_(actions_, {compact ? command_id : kNotQueued,
+    compact ? 0 : AppendText_(command), command.size(), value, true, false, compact,
+    false, Clock::now()});
+}
+
+void OutboundQueue::SetCompact(bool compact) noexcept {
+  compact_ = compact;
+  if (!compact) // the plugin may no longer read compact lines: write them as text
+    for (auto* lane : {&actions_, &entries_})
+      for (auto& entry : *lane)
+        entry.compact = false;
+  Barrier_(); // merged values keep the form they were queued in
+}
+
+void OutboundQueue::SetLimit(size_t entries, QUEUE_FULL_POLICY policy) noexcept {
+  limit_ = std::max<size_t>(entries, 1);
+  policy_ = policy;
+}
+
+void OutboundQueue::DrainLane_(std::vector<Entry>& lane, LaneLatency& latency,
+  Clock::time_point now, std::string& out, size_t& compact_line) {
+  char number[32];
+  for (const auto& entry : lane) {
+    if (entry.dropped)
+      continue;
+    const auto waited =
+      std::chrono::duration<double, std::milli>(now - entry.queued).count();
+    ++latency.sent;
+    latency.total_ms += waited;
+    latency.max_ms = std::max(latency.max_ms, waited);
+    if (entry.compact) {
+      if (compact_line == CompactProtocol::kMaxUpdates) {
+        out.push_back('\n');
+        compact_line = 0;
+      }
+      if (compact_line++ == 0)
+        out.push_back(CompactProtocol::kMarker);
+      out.append(number,
+        CompactProtocol::Encode(entry.command_id, entry.value, number) - number);
+      continue;
+    }
+    if (compact_line) {
+      out.push_back('\n');
+      compact_line = 0;
+    }
+    if (entry.command_id != kNotQueued)
+      out.append(prefixes_[entry.command_id]);
+    else {
+      out.append(text_, entry.text, entry.length);
+      if (entry.has_value)
+        out.push_back(' ');
+    }
+    if (entry.has_value) {
+      auto* end = FormatValue(entry.value, number);
+      *end++ = '\n';
+      out.append(number, static_cast<size_t>(end - number));
+    }
+  }
+  lane.clear();
+}
+
+void OutboundQueue::Drain(std::string& out) {
+  const auto now = Clock::now();
+  size_t compact_line = 0; // values on the open compact line
+  DrainLane_(actions_, latency_[0], now, out, compact_line);
+  DrainLane_(entries_, latency_[1], now, out, compact_line);
+  if (compact_line)
+    out.push_back('\n');
+  text_.clear();
+  size_ = 0;
+  oldest_value_ = 0;
+  evicted_ = 0;
+  Barrier_();
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+/*
+  ==============================================================================
+
+    OutboundQueue.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef OUTBOUNDQUEUE_H_INCLUDED
+#define OUTBOUNDQUEUE_H_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// what OutboundQueue does with a value when it already holds its limit
+enum class QUEUE_FULL_POLICY {
+  DROP_NEWEST, // the new value is discarded
+  DROP_OLDEST_VALUE // the oldest continuous value makes room, else as DROP_NEWEST
+};
+
+// the queues OutboundQueue drains, in the order they are written
+enum class OUTBOUND_LANE {
+  ACTIONS, // lines, notes, macros and button presses, in order
+  VALUES // continuous values, merged per command
+};
+
+class OutboundQueue {
+  // Commands waiting to be written to the plugin, in two lanes. Actions are
+  // written ahead of values, so a button pressed while a fader moves isn't
+  // held behind the fader's backlog; both lanes are drained together, so
+  // values are never starved. A new value for a command that already has a
+  // value queued replaces it in place, so a fader sweep reaches Lightroom as
+  // its latest position rather than every step. Values above the plugin's
+  // button threshold are never replaced, as Lightroom treats them as a
+  // button press; they go in the values lane only if the command has a value
+  // queued there, which keeps each command's values in order. An action for
+  // a command, or one resetting it, drops the command's queued value, which
+  // would otherwise be written after the action and undo it.
+  // Nothing is allocated per command once the buffers have grown to the
+  // busiest window: Lightroom commands are queued by index and written from
+  // a prebuilt "command " prefix, other text is copied into one buffer, and
+  // values are formatted by hand. In compact mode (see CompactProtocol.h)
+  // values for Lightroom commands are written as compact lines instead.
+  // The queue holds at most limit() entries, so a stalled socket can't build
+  // up a backlog of stale values; merging needs no room. Lines from the app
+  // itself (PushLine) are always queued.
+public:
+  OutboundQueue();
+  ~OutboundQueue() {};
+
+  // queues a complete line, including its newline
+  void PushLine(const std::string& line);
+  // queues value (0.0-1.0) for command, merging with a queued value if any.
+  // command_id is the command's index in LRCommandList::LRStringList, if it
+  // is one, so it can be found without comparing strings
+  void PushValue(const std::string& command, size_t command_id, double value);
+  // queues value for command as a discrete line, never merged
+  void PushDiscreteValue(const std::string& command, double value);
+  // whether values queued from now on are written as compact lines; turning
+  // it off also writes those already queued as text
+  void SetCompact(bool compact) noexcept;
+  // entries held before policy applies to new values
+  void SetLimit(size_t entries, QUEUE_FULL_POLICY policy) noexcept;
+  // appends all queued lines to out, actions first, and empties the queue.
+  // out keeps its capacity between calls if the caller reuses it
+  void Drain(std::string& out);
+
+  inline bool empty() const noexcept {
+    return size_ == 0;
+  };
+
+  // whether actions are waiting, which shouldn't wait for merging
+  inline bool urgent() const noexcept {
+    return !actions_.empty();
+  };
+
+  struct LaneLatency {
+    size_t sent; // entries drained
+    double total_ms; // time from queueing to draining, summed
+    double max_ms;
+  };
+  // since construction
+  inline const LaneLatency& latency(OUTBOUND_LANE lane) const noexcept {
+    return latency_[lane == OUTBOUND_LANE::ACTIONS ? 0 : 1];
+  };
+
+  // entries waiting to be drained
+  inline size_t size() const noexcept {
+    return size_;
+  };
+
+  inline size_t limit() const noexcept {
+    return limit_;
+  };
+
+  // most entries held at once since construction
+  inline size_t high_water() const noexcept {
+    return high_water_;
+  };
+
+  // number of values replaced by a newer one, or dropped for an action on
+  // their command, since construction
+  inline size_t merged() const noexcept {
+    return merged_;
+  };
+
+  // number of values discarded at the limit since construction
+  inline size_t dropped() const noexcept {
+    return dropped_;
+  };
+
+private:
+  static constexpr size_t kNotQueued = static_cast<size_t>(-1);
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    size_t command_id; // LRStringList index, or kNotQueued if text is the command
+    size_t text; // offset in text_ of the command or complete line
+    size_t length;
+    double value;
+    bool has_value;
+    bool mergeable; // a value that later values for the command replace
+    bool compact;
+    bool dropped; // evicted at the limit, not written
+    Clock::time_point queued;
+  };
+
+  void Barrier_() noexcept;
+  size_t AppendText_(const std::string& text);
+  void Append_(std::vector<Entry>& lane, const Entry& entry);
+  void DrainLane_(std::vector<Entry>& lane, LaneLatency& latency,
+    Clock::time_point now, std::string& out, size_t& compact_line);
+  // false if policy_ says the new value goes
+  bool MakeRoom_();
+  // drops the queued value of command_id and of the parameter it resets,
+  // before an action for command_id is queued
+  void Supersede_(size_t command_id);
+  // removes dropped entries, keeping merges with the entries that remain
+  void Compact_();
+
+  QUEUE_FULL_POLICY policy_{QUEUE_FULL_POLICY::DROP_OLDEST_VALUE};
+  size_t limit_;
+  size_t size_{0}; // entries in both lanes less those dropped
+  size_t oldest_value_{0}; // entries_ before this hold no continuous value
+  size_t evicted_{0}; // entries_ marked dropped, not yet compacted away
+  size_t high_water_{0};
+  size_t merged_{0};
+  size_t dropped_{0};
+  size_t barrier_{0}; // entries_ before this are never merged into
+  bool compact_{false};
+  std::vector<Entry> actions_;
+  std::vector<Entry> entries_; // the values lane
+  LaneLatency latency_[2]{};
+  std::string text_;
+  std::vector<std::string> prefixes_; // "command " by LRStringList index
+  std::vector<size_t> value_index_; // by LRStringList index, into entries_
+  // by LRStringList index, the parameter a "Reset..." command resets
+  std::vector<size_t> reset_targets_;
+  std::vector<size_t> indexed_; // ids set in value_index_ since the barrier
+};
+
+#endif  // OUTBOUNDQUEUE_H_INCLUDED
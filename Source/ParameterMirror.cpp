@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    ParameterMirror.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ParameterMirror.h"
+#include <cmath>
+#include <limits>
+#include "LRCommands.h"
+
+namespace {
+  constexpr double kPickupThreshold = 0.03; // roughly 4/127
+  // a moving control keeps the parameter this long after its last value, as
+  // the values Lightroom reports lag those sent
+  constexpr double kPickupHold = 0.5;
+}
+
+ParameterMirror::ParameterMirror():
+  values_(LRCommandList::LRStringList.size(),
+    Parameter{0.0, -std::numeric_limits<double>::infinity(), false}) {}
+
+bool ParameterMirror::Get(size_t command_id, double& value) const {
+  if (command_id >= values_.size())
+    return false;
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  const auto& parameter = values_[command_id];
+  if (!parameter.reported)
+    return false;
+  value = parameter.value;
+  return true;
+}
+
+void ParameterMirror::Set(size_t command_id, double value) {
+  if (command_id == 0 || command_id >= values_.size()) // 0 is "Unmapped"
+    return;
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  auto& parameter = values_[command_id];
+  parameter.value = value;
+  parameter.reported = true;
+}
+
+void ParameterMirror::Update(size_t command_id, double value) {
+  if (command_id >= values_.size())
+    return;
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  auto& parameter = values_[command_id];
+  if (parameter.reported)
+    parameter.value = value;
+}
+
+bool ParameterMirror::PickUp(size_t command_id, double value, double timestamp,
+  double& target) {
+  if (command_id >= values_.size()) // not a parameter, nothing to pick up
+    return true;
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  auto& parameter = values_[command_id];
+  if (!parameter.reported)
+    return true;
+  if (std::abs(value - parameter.value) > kPickupThreshold &&
+    timestamp - parameter.picked_up > kPickupHold) {
+    target = parameter.value;
+    return false;
+  }
+  parameter.value = value;
+  parameter.picked_up = timestamp;
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ParameterMirror.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef PARAMETERMIRROR_H_INCLUDED
+#define PARAMETERMIRROR_H_INCLUDED
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "Utilities/Utilities.h"
+
+class ParameterMirror {
+  // Latest known value (0.0-1.0) of each Lightroom parameter, fed by the
+  // values the plugin reports and by the values sent to it. Lets relative
+  // controls step from the current value without asking Lightroom, and
+  // absolute controls pick up the parameter without the plugin comparing
+  // each value. Parameters are indexed by command id (the index in
+  // LRCommandList::LRStringList); other ids are never parameters.
+public:
+  ParameterMirror();
+  ~ParameterMirror() {};
+
+  // returns false if Lightroom hasn't reported command_id yet
+  bool Get(size_t command_id, double& value) const;
+  // a value Lightroom reported; only these make a command a parameter
+  void Set(size_t command_id, double value);
+  // a value sent to Lightroom, kept only for a command it has reported
+  void Update(size_t command_id, double value);
+
+  // soft takeover: an absolute control moves a parameter only once its
+  // value comes near the parameter's, and keeps it while moving. returns
+  // true and records value if the control has the parameter, else false
+  // with the parameter's value in target. commands Lightroom hasn't
+  // reported, such as actions, resets and presets, always pass and aren't
+  // recorded. timestamp is in seconds
+  bool PickUp(size_t command_id, double value, double timestamp, double& target);
+
+private:
+  mutable RSJ::spinlock mutex_; //fast spinlock for brief use
+  struct Parameter {
+    double value;
+    double picked_up; // timestamp of the last value PickUp let through
+    bool reported; // Lightroom has reported a value
+  };
+  std::vector<Parameter> values_; // by command id, sized once
+};
+
+#endif  // PARAMETERMIRROR_H_INCLUDED
@@ -39,7 +39,8 @@ void ProfileManager::Init(std::weak_ptr<LR_IPC_OUT>&& out,
   }
 
   if (midiProcessor) {
-    midiProcessor->addMIDICommandListener(this);
+    midiProcessor->addMIDICommandListener(this,
+      MIDI_SUBSCRIPTION::PROFILE_NAVIGATION);
   }
 }
 
@@ -95,6 +96,14 @@ void ProfileManager::switchToProfile(const juce::String& profile) {
   }
 }
 
+void ProfileManager::QueueProfile(const juce::String& profile) {
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    requested_profile_ = profile;
+  }
+  triggerAsyncUpdate();
+}
+
 void ProfileManager::switchToNextProfile() {
   current_profile_index_++;
   if (current_profile_index_ == static_cast<int>(profiles_.size()))
@@ -110,42 +119,20 @@ void ProfileManager::switchToPreviousProfile() {
   switchToProfile(current_profile_index_);
 }
 
-void ProfileManager::handleMidiCC(int midi_channel, int controller, int value) {
-  const MIDI_Message_ID cc{midi_channel, controller, true};
-
-  if (command_map_) {
-      // return if the value isn't 127, or the command isn't a valid
-      // profile-related command
-    if ((value != 127) || !command_map_->messageExistsInMap(cc))
-      return;
+void ProfileManager::handleMidiCommand(const MIDI_Command_Event& event) {
+  // only act when the value is at maximum
+  if (event.value != event.max_value)
+    return;
 
-    if (command_map_->getCommandforMessage(cc) == "Previous Profile") {
-      switch_state_ = SWITCH_STATE::PREV;
-      triggerAsyncUpdate();
-    }
-    else if (command_map_->getCommandforMessage(cc) == "Next Profile") {
-      switch_state_ = SWITCH_STATE::NEXT;
-      triggerAsyncUpdate();
-    }
+  // command ids for NextPrevProfile follow those for LRStringList
+  const auto profile_command = event.command_id - LRCommandList::LRStringList.size();
+  if (profile_command == 0) { // Previous Profile
+    switch_state_ = SWITCH_STATE::PREV;
+    triggerAsyncUpdate();
   }
-}
-
-void ProfileManager::handleMidiNote(int midi_channel, int note) {
-  const MIDI_Message_ID note_msg{midi_channel, note, false};
-
-  if (command_map_) {
-      // return if the command isn't a valid profile-related command
-    if (!command_map_->messageExistsInMap(note_msg))
-      return;
-
-    if (command_map_->getCommandforMessage(note_msg) == "Previous Profile") {
-      switch_state_ = SWITCH_STATE::PREV;
-      triggerAsyncUpdate();
-    }
-    else if (command_map_->getCommandforMessage(note_msg) == "Next Profile") {
-      switch_state_ = SWITCH_STATE::NEXT;
-      triggerAsyncUpdate();
-    }
+  else if (profile_command == 1) { // Next Profile
+    switch_state_ = SWITCH_STATE::NEXT;
+    triggerAsyncUpdate();
   }
 }
 
@@ -161,6 +148,13 @@ void ProfileManager::connected() {
 void ProfileManager::disconnected() {}
 
 void ProfileManager::handleAsyncUpdate() {
+  juce::String requested_profile;
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    requested_profile.swapWith(requested_profile_);
+  }
+  if (requested_profile.isNotEmpty())
+    switchToProfile(requested_profile);
   switch (switch_state_) {
     case SWITCH_STATE::PREV:
       switchToPreviousProfile();
@@ -23,6 +23,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define PROFILEMANAGER_H_INCLUDED
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CommandMap.h"
@@ -60,6 +61,10 @@ class ProfileManager final: public MIDICommandListener,
   // switches to a profile defined by a name
   void switchToProfile(const juce::String& profile);
 
+  // switches to a profile defined by a name on the message thread, for the
+  // plugin's SwitchProfile from the reactor thread
+  void QueueProfile(const juce::String& profile);
+
   // switches to the next profile
   void switchToNextProfile();
 
@@ -67,8 +72,7 @@ class ProfileManager final: public MIDICommandListener,
   void switchToPreviousProfile();
 
   // MIDICommandListener interface
-  virtual void handleMidiCC(int midi_channel, int controller, int value) override;
-  virtual void handleMidiNote(int midi_channel, int note) override;
+  virtual void handleMidiCommand(const MIDI_Command_Event& event) override;
 
   // LRConnectionListener interface
   virtual void connected() override;
@@ -93,6 +97,8 @@ class ProfileManager final: public MIDICommandListener,
   std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
   std::vector<juce::String> profiles_;
   SWITCH_STATE switch_state_;
+  std::mutex requested_mutex_;
+  juce::String requested_profile_; // by QueueProfile, guarded by requested_mutex_
 };
 
 #endif  // PROFILEMANAGER_H_INCLUDED
@@ -26,7 +26,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 namespace {
   constexpr auto SettingsLeft = 20;
   constexpr auto SettingsWidth = 400;
-  constexpr auto SettingsHeight = 300;
+  constexpr auto SettingsHeight = 360;
 }
 
 SettingsComponent::SettingsComponent(): ResizableLayout{this} {}
@@ -102,6 +102,18 @@ void SettingsComponent::Init(std::weak_ptr<SettingsManager>&& settings_manager)
     //add this as the lister for the data
     autohide_setting_.addListener(this);
     addAndMakeVisible(autohide_setting_);
+
+    // ---------------------------- learn section -------------------------------------
+    learn_group_.setText("MIDI learn");
+    learn_group_.setBounds(0, 300, SettingsWidth, 60);
+    addToLayout(&learn_group_, anchorMidLeft, anchorMidRight);
+    addAndMakeVisible(learn_group_);
+
+    learn_per_device_.addListener(this);
+    learn_per_device_.setToggleState(ptr->getLearnPerDevice(), juce::NotificationType::dontSendNotification);
+    learn_per_device_.setBounds(SettingsLeft, 320, SettingsWidth - 2 * SettingsLeft, 32);
+    addToLayout(&learn_per_device_, anchorMidLeft, anchorMidRight);
+    addAndMakeVisible(learn_per_device_);
     // turn it on
     activateLayout();
   }
@@ -116,6 +128,10 @@ void SettingsComponent::buttonClicked(Button* button) {
     if (const auto ptr = settings_manager_.lock())
       ptr->setPickupEnabled(pickup_enabled_.getToggleState());
   }
+  else if (button == &learn_per_device_) {
+    if (const auto ptr = settings_manager_.lock())
+      ptr->setLearnPerDevice(learn_per_device_.getToggleState());
+  }
   else if (button == &profile_location_button_) {
     FileBrowserComponent browser{
       FileBrowserComponent::canSelectDirectories | FileBrowserComponent::openMode,
@@ -42,6 +42,7 @@ class SettingsComponent final:
   virtual void sliderValueChanged(juce::Slider* slider) override;
 
   juce::GroupComponent autohide_group_{};
+  juce::GroupComponent learn_group_{};
   juce::GroupComponent pickup_group_{};
   juce::GroupComponent profile_group_{};
   juce::Label autohide_explain_label_{};
@@ -51,6 +52,7 @@ class SettingsComponent final:
   std::weak_ptr<SettingsManager> settings_manager_;
   juce::TextButton profile_location_button_{"Choose Profile Folder"};
   juce::ToggleButton pickup_enabled_{"Enable Pickup Mode"};
+  juce::ToggleButton learn_per_device_{"Learn controls for their device only"};
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SettingsComponent)
 };
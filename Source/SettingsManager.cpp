@@ -24,6 +24,12 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "ProfileManager.h"
 
 const juce::String AutoHideSection{"autohide"};
+const juce::String NRPNTimeoutSection{"nrpn_timeout"};
+const juce::String CoalesceWindowSection{"coalesce_window"};
+const juce::String OutboundLimitSection{"outbound_limit"};
+constexpr int kDefaultOutboundLimit = 256;
+const juce::String OutboundPolicySection{"outbound_policy"};
+const juce::String InputFiltersSection{"input_filters"};
 
 SettingsManager::SettingsManager() {
   juce::PropertiesFile::Options file_options;
@@ -37,10 +43,21 @@ SettingsManager::SettingsManager() {
 }
 
 void SettingsManager::Init(std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out,
-  std::weak_ptr<ProfileManager>&& profile_manager) {
+  std::weak_ptr<ProfileManager>&& profile_manager,
+  std::weak_ptr<MIDIProcessor>&& midi_processor) {
   lr_ipc_out_ = std::move(lr_ipc_out);
+  midi_processor_ = std::move(midi_processor);
+
+  if (const auto ptr = midi_processor_.lock()) {
+    ptr->SetNRPNTimeout(getNRPNTimeout());
+    ptr->SetPickupEnabled(getPickupEnabled());
+    for (const auto& filter : getInputFilters())
+      ptr->SetInputFilter(filter.first, filter.second);
+  }
 
   if (const auto ptr = lr_ipc_out_.lock()) {
+    ptr->SetCoalesceWindow(getCoalesceWindow());
+    ptr->SetQueueLimit(static_cast<size_t>(getOutboundLimit()), getOutboundPolicy());
       // add ourselves as a listener to LR_IPC_OUT so that we can send plugin
       // settings on connection
     ptr->addListener(this);
@@ -62,9 +79,9 @@ void SettingsManager::setPickupEnabled(bool enabled) {
   properties_file_->setValue("pickup_enabled", enabled);
   properties_file_->saveIfNeeded();
 
-  if (const auto ptr = lr_ipc_out_.lock()) {
-    ptr->sendCommand("Pickup " + std::to_string(static_cast<unsigned>(enabled)) + '\n');
-  }
+  // pickup is applied to values before they are sent to the plugin
+  if (const auto ptr = midi_processor_.lock())
+    ptr->SetPickupEnabled(enabled);
 }
 juce::String SettingsManager::getProfileDirectory() const noexcept {
   return properties_file_->getValue("profile_directory");
@@ -78,11 +95,7 @@ void SettingsManager::setProfileDirectory(const juce::String& profile_directory_
   }
 }
 
-void SettingsManager::connected() {
-  if (const auto ptr = lr_ipc_out_.lock()) {
-    ptr->sendCommand("Pickup " + std::to_string(static_cast<unsigned>(getPickupEnabled())) + '\n');
-  }
-}
+void SettingsManager::connected() {}
 
 void SettingsManager::disconnected() {}
 
@@ -102,4 +115,112 @@ int SettingsManager::getLastVersionFound() const noexcept {
 void SettingsManager::setLastVersionFound(int new_version) {
   properties_file_->setValue("LastVersionFound", new_version);
   properties_file_->saveIfNeeded();
+}
+
+int SettingsManager::getNRPNTimeout() const noexcept {
+  return properties_file_->getIntValue(NRPNTimeoutSection,
+    MIDIProcessor::kDefaultNRPNTimeout);
+}
+
+void SettingsManager::setNRPNTimeout(int milliseconds) {
+  properties_file_->setValue(NRPNTimeoutSection, milliseconds);
+  properties_file_->saveIfNeeded();
+  if (const auto ptr = midi_processor_.lock()) {
+    ptr->SetNRPNTimeout(milliseconds);
+  }
+}
+
+bool SettingsManager::getLearnPerDevice() const noexcept {
+  return properties_file_->getBoolValue("learn_per_device", false);
+}
+
+void SettingsManager::setLearnPerDevice(bool per_device) {
+  properties_file_->setValue("learn_per_device", per_device);
+  properties_file_->saveIfNeeded();
+}
+
+int SettingsManager::getCoalesceWindow() const noexcept {
+  return properties_file_->getIntValue(CoalesceWindowSection,
+    LR_IPC_OUT::kDefaultCoalesceWindow);
+}
+
+void SettingsManager::setCoalesceWindow(int milliseconds) {
+  properties_file_->setValue(CoalesceWindowSection, milliseconds);
+  properties_file_->saveIfNeeded();
+  if (const auto ptr = lr_ipc_out_.lock()) {
+    ptr->SetCoalesceWindow(milliseconds);
+  }
+}
+
+int SettingsManager::getOutboundLimit() const noexcept {
+  const auto entries = properties_file_->getIntValue(OutboundLimitSection,
+    kDefaultOutboundLimit);
+  return entries > 0 ? entries : kDefaultOutboundLimit;
+}
+
+void SettingsManager::setOutboundLimit(int entries) {
+  properties_file_->setValue(OutboundLimitSection, entries);
+  properties_file_->saveIfNeeded();
+  if (const auto ptr = lr_ipc_out_.lock()) {
+    ptr->SetQueueLimit(static_cast<size_t>(getOutboundLimit()), getOutboundPolicy());
+  }
+}
+
+QUEUE_FULL_POLICY SettingsManager::getOutboundPolicy() const noexcept {
+  // stored as a number, anything unknown is the default
+  return properties_file_->getIntValue(OutboundPolicySection,
+    static_cast<int>(QUEUE_FULL_POLICY::DROP_OLDEST_VALUE)) ==
+    static_cast<int>(QUEUE_FULL_POLICY::DROP_NEWEST) ?
+    QUEUE_FULL_POLICY::DROP_NEWEST : QUEUE_FULL_POLICY::DROP_OLDEST_VALUE;
+}
+
+void SettingsManager::setOutboundPolicy(QUEUE_FULL_POLICY policy) {
+  properties_file_->setValue(OutboundPolicySection, static_cast<int>(policy));
+  properties_file_->saveIfNeeded();
+  if (const auto ptr = lr_ipc_out_.lock()) {
+    ptr->SetQueueLimit(static_cast<size_t>(getOutboundLimit()), policy);
+  }
+}
+
+std::map<juce::String, MIDI_InputFilter> SettingsManager::getInputFilters() const {
+  std::map<juce::String, MIDI_InputFilter> filters;
+  const std::unique_ptr<juce::XmlElement>
+    root{properties_file_->getXmlValue(InputFiltersSection)};
+  if (root) {
+    forEachXmlChildElementWithTagName(*root, device, "device") {
+      MIDI_InputFilter filter;
+      filter.open = device->getBoolAttribute("open", true);
+      filter.notes = device->getBoolAttribute("notes", true);
+      filter.controllers = device->getBoolAttribute("controllers", true);
+      filter.pitch_bend = device->getBoolAttribute("pitch_bend", false);
+      filter.pressure = device->getBoolAttribute("pressure", false);
+      filter.channels = static_cast<std::uint16_t>(
+        device->getIntAttribute("channels", 0xFFFF));
+      filters[device->getStringAttribute("name")] = filter;
+    }
+  }
+  return filters;
+}
+
+void SettingsManager::setInputFilter(const juce::String& device_name,
+  const MIDI_InputFilter& filter) {
+  auto filters = getInputFilters();
+  filters[device_name] = filter;
+  juce::XmlElement root{"input_filters"};
+  for (const auto& entry : filters) {
+    auto* device = root.createNewChildElement("device");
+    device->setAttribute("name", entry.first);
+    device->setAttribute("open", entry.second.open);
+    device->setAttribute("notes", entry.second.notes);
+    device->setAttribute("controllers", entry.second.controllers);
+    device->setAttribute("pitch_bend", entry.second.pitch_bend);
+    device->setAttribute("pressure", entry.second.pressure);
+    device->setAttribute("channels", static_cast<int>(entry.second.channels));
+  }
+  properties_file_->setValue(InputFiltersSection, &root);
+  properties_file_->saveIfNeeded();
+  if (const auto ptr = midi_processor_.lock()) {
+    ptr->SetInputFilter(device_name, filter);
+    ptr->RescanDevices();
+  }
 }
\ No newline at end of file
@@ -22,9 +22,11 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef SETTINGSMANAGER_H_INCLUDED
 #define SETTINGSMANAGER_H_INCLUDED
 
+#include <map>
 #include <memory>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "LR_IPC_OUT.h"
+#include "MIDIProcessor.h"
 #include "ProfileManager.h"
 
 class SettingsManager final: public LRConnectionListener {
@@ -32,7 +34,8 @@ class SettingsManager final: public LRConnectionListener {
   SettingsManager();
   virtual ~SettingsManager() {};
   void Init(std::weak_ptr<LR_IPC_OUT>&& lr_IPC_OUT,
-    std::weak_ptr<ProfileManager>&& profile_manager);
+    std::weak_ptr<ProfileManager>&& profile_manager,
+    std::weak_ptr<MIDIProcessor>&& midi_processor);
 
   bool getPickupEnabled() const noexcept;
   void setPickupEnabled(bool enabled);
@@ -50,10 +53,36 @@ class SettingsManager final: public LRConnectionListener {
   int getLastVersionFound() const noexcept;
   void setLastVersionFound(int version_number);
 
+  // milliseconds an NRPN value MSB may wait for its LSB
+  int getNRPNTimeout() const noexcept;
+  void setNRPNTimeout(int milliseconds);
+
+  // whether MIDI learn maps a control for the device it came from only,
+  // rather than for any device
+  bool getLearnPerDevice() const noexcept;
+  void setLearnPerDevice(bool per_device);
+
+  // milliseconds over which values sent to Lightroom are merged
+  int getCoalesceWindow() const noexcept;
+  void setCoalesceWindow(int milliseconds);
+
+  // most values waiting for Lightroom, and which go when more arrive
+  int getOutboundLimit() const noexcept;
+  void setOutboundLimit(int entries);
+  QUEUE_FULL_POLICY getOutboundPolicy() const noexcept;
+  void setOutboundPolicy(QUEUE_FULL_POLICY policy);
+
+  // per-device MIDI IN filters, keyed by device name
+  std::map<juce::String, MIDI_InputFilter> getInputFilters() const;
+  // saves the filter and reopens the MIDI IN devices to apply it
+  void setInputFilter(const juce::String& device_name,
+    const MIDI_InputFilter& filter);
+
 private:
 
   std::unique_ptr<juce::PropertiesFile> properties_file_;
   std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+  std::weak_ptr<MIDIProcessor> midi_processor_;
   std::weak_ptr<ProfileManager> profile_manager_;
 };
 
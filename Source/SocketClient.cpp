@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    SocketClient.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "SocketClient.h"
+#include <algorithm>
+#include <utility>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#endif
+
+namespace {
+  constexpr size_t kMaxTransfer = 1 << 20; // keeps lengths in an int
+#ifdef _WIN32
+  using NativeSocket = SOCKET;
+  constexpr int kSendFlags = 0;
+#else
+  using NativeSocket = int;
+#ifdef MSG_NOSIGNAL
+  constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+  constexpr int kSendFlags = 0; // SO_NOSIGPIPE is set instead
+#endif
+#endif
+
+  void SetNonBlocking(NativeSocket handle) {
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(handle, FIONBIO, &on);
+#else
+    fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+#endif
+  }
+
+  bool WouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+  }
+}
+
+bool SocketClient::Connect(const juce::String& host, int port, int timeout_ms) {
+  // connect outside the lock, so writers aren't held for the timeout
+  auto socket = std::make_unique<juce::StreamingSocket>();
+  if (!socket->connect(host, port, timeout_ms))
+    return false;
+  SetNonBlocking(static_cast<NativeSocket>(socket->getRawSocketHandle()));
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  socket_ = std::move(socket);
+  if (++connections_ == 0) // 0 means not connected
+    ++connections_;
+  connection_ = connections_;
+  return true;
+}
+
+void SocketClient::Close() {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  socket_.reset(); // closes it
+  connection_ = 0;
+}
+
+bool SocketClient::IsConnected() const {
+  return Connection() != 0;
+}
+
+unsigned int SocketClient::Connection() const {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  return connection_;
+}
+
+int SocketClient::GetHandle() const {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  return socket_ ? socket_->getRawSocketHandle() : -1;
+}
+
+int SocketClient::Write(const char* data, size_t length, unsigned int connection) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  if (!socket_ || connection != connection_)
+    return -1;
+  const auto sent = ::send(static_cast<NativeSocket>(socket_->getRawSocketHandle()),
+    data, static_cast<int>(std::min(length, kMaxTransfer)), kSendFlags);
+  if (sent < 0)
+    return WouldBlock() ? 0 : -1;
+  return static_cast<int>(sent);
+}
+
+int SocketClient::Read(char* data, size_t size) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  if (!socket_)
+    return -1;
+  const auto received = ::recv(static_cast<NativeSocket>(socket_->getRawSocketHandle()),
+    data, static_cast<int>(std::min(size, kMaxTransfer)), 0);
+  if (received == 0)
+    return -1; // closed by the plugin
+  if (received < 0)
+    return WouldBlock() ? 0 : -1;
+  return static_cast<int>(received);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+/*
+  ==============================================================================
+
+    SocketClient.h
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef SOCKETCLIENT_H_INCLUDED
+#define SOCKETCLIENT_H_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+class SocketClient {
+  // A TCP connection to the plugin without a thread of its own: IOReactor
+  // connects, reads, watches and closes it; anyone may write. Once connected
+  // the socket doesn't block, so a write takes only what fits in the
+  // socket's buffer and a read only what has arrived.
+public:
+  SocketClient() noexcept {};
+  ~SocketClient() {};
+
+  // blocks for at most timeout_ms, false if nothing is listening
+  bool Connect(const juce::String& host, int port, int timeout_ms);
+  void Close();
+  bool IsConnected() const;
+  // numbers each connection from 1, 0 while not connected
+  unsigned int Connection() const;
+  // handle to wait on, -1 while not connected
+  int GetHandle() const;
+  // writes what the socket takes: the number of bytes, 0 if it is full, -1
+  // if the connection has failed or isn't connection any more
+  int Write(const char* data, size_t length, unsigned int connection);
+  // the number of bytes read, 0 if none have arrived, -1 if the plugin has
+  // closed the connection or it has failed
+  int Read(char* data, size_t size);
+
+private:
+  mutable std::mutex mutex_; // Write may come from any thread
+  std::unique_ptr<juce::StreamingSocket> socket_;
+  unsigned int connection_{0};
+  unsigned int connections_{0};
+};
+
+#endif  // SOCKETCLIENT_H_INCLUDED
@@ -24,13 +24,19 @@ static constexpr bool ndebug = true;
 static constexpr bool ndebug = false;
 #endif
 
+#include <array>
 #include <atomic>
+#include <cassert>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <utility>
+#include <vector>
 namespace RSJ {
   template <typename T>
   struct counter {
@@ -141,6 +147,229 @@ lock_guard<RSJ::spinlock> guard(lock);
     }
   };
 
+  // Bounded single-producer/single-consumer ring. push and pop are wait-free:
+  // each index is written by exactly one side, so no locks or CAS loops are
+  // needed. Capacity must be a power of two; indices run freely and are masked.
+  template<typename T, std::size_t Capacity>
+  class spsc_ring {
+    static_assert(Capacity && ((Capacity & (Capacity - 1)) == 0),
+      "spsc_ring capacity must be a power of two");
+  public:
+    spsc_ring() noexcept {}
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // producer side. returns false, leaving the ring untouched, if full
+    bool push(const T& value) noexcept {
+      const auto tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) == Capacity)
+        return false;
+      buffer_[tail & kMask] = value;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+    // consumer side. returns nullptr if empty
+    const T* front() const noexcept {
+      const auto head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire))
+        return nullptr;
+      return &buffer_[head & kMask];
+    }
+    // consumer side. only call after front() returned non-null
+    void pop_front() noexcept {
+      head_.store(head_.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+    }
+    bool pop(T& value) noexcept {
+      const auto* item = front();
+      if (item == nullptr)
+        return false;
+      value = *item;
+      pop_front();
+      return true;
+    }
+    // consumer side, discards everything queued
+    void clear() noexcept {
+      head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    // approximate when called concurrently with push or pop
+    std::size_t size() const noexcept {
+      return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    static constexpr std::size_t capacity() noexcept {
+      return Capacity;
+    }
+  private:
+    static constexpr std::size_t kMask = Capacity - 1;
+    static constexpr std::size_t kCacheLine = 64;
+    // keep the two indices on separate cache lines so producer and consumer
+    // don't fight over ownership of the same line
+    std::atomic<std::size_t> head_{0};
+    char head_pad_[kCacheLine - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail_{0};
+    char tail_pad_[kCacheLine - sizeof(std::atomic<std::size_t>)];
+    std::array<T, Capacity> buffer_;
+  };
+
+  // Publishes immutable versions of a T to any number of reader threads.
+  // Readers pin the current version wait-free: they record the epoch they
+  // started in, then load the pointer. The writer (one thread at a time)
+  // swaps in a new version, advances the epoch and frees a retired version
+  // once every pinned reader started in a later epoch, as only readers that
+  // started earlier can still hold it. Versions are shared, so the writer may
+  // keep several resident and switch between them by publishing each again.
+  // Each reader thread takes a slot the first time it pins and returns it
+  // when the thread exits. Past MaxReaders live reader threads, the rest
+  // share one more slot under a spinlock.
+  template<typename T, std::size_t MaxReaders = 32>
+  class snapshot_ptr {
+  public:
+    // a pinned version, valid until the pin is destroyed. pins nest, but
+    // must be released on the thread that took them
+    class pin {
+    public:
+      pin(pin&& other) noexcept:
+        owner_{other.owner_}, slot_{other.slot_}, value_{other.value_} {
+        other.owner_ = nullptr;
+      }
+      pin(const pin&) = delete;
+      pin& operator=(const pin&) = delete;
+      pin& operator=(pin&&) = delete;
+      ~pin() {
+        if (owner_)
+          owner_->unpin_(slot_);
+      }
+      const T* get() const noexcept {
+        return value_;
+      }
+      const T* operator->() const noexcept {
+        return value_;
+      }
+      const T& operator*() const noexcept {
+        return *value_;
+      }
+      explicit operator bool() const noexcept {
+        return value_ != nullptr;
+      }
+    private:
+      friend class snapshot_ptr;
+      pin(const snapshot_ptr* owner, std::size_t slot, const T* value) noexcept:
+        owner_{owner}, slot_{slot}, value_{value} {}
+      const snapshot_ptr* owner_;
+      std::size_t slot_;
+      const T* value_;
+    };
+
+    snapshot_ptr() noexcept {}
+    explicit snapshot_ptr(std::shared_ptr<const T> initial) noexcept:
+      current_{initial.get()}, owner_{std::move(initial)} {}
+    snapshot_ptr(const snapshot_ptr&) = delete;
+    snapshot_ptr& operator=(const snapshot_ptr&) = delete;
+    ~snapshot_ptr() {} // no pins may outlive this
+
+    // reader side, wait-free
+    pin acquire() const noexcept {
+      const auto slot = reader_slot_();
+      auto& reader = readers_[slot];
+      if (slot == kShared) {
+        // the first pin's epoch is the oldest, so it covers the later ones
+        std::lock_guard<spinlock> lock(shared_lock_);
+        if (reader.depth++ == 0)
+          reader.epoch.store(epoch_.load());
+        return pin{this, slot, current_.load()};
+      }
+      // the epoch store must be visible before the pointer load, or the
+      // writer could free the version loaded here
+      if (reader.depth++ == 0)
+        reader.epoch.store(epoch_.load());
+      return pin{this, slot, current_.load()};
+    }
+
+    // writer side. the previous version is released once no reader holds it
+    void publish(std::shared_ptr<const T> next) {
+      current_.store(next.get());
+      const auto retired_at = epoch_.fetch_add(1) + 1;
+      if (owner_)
+        retired_.emplace_back(std::move(owner_), retired_at);
+      owner_ = std::move(next);
+      reclaim();
+    }
+
+    // writer side. releases the retired versions no reader can still hold;
+    // publish calls this, versions pinned at the time wait for the next call
+    void reclaim() {
+      auto oldest = UINT64_MAX;
+      for (const auto& reader : readers_) {
+        const auto epoch = reader.epoch.load();
+        if (epoch != 0 && epoch < oldest)
+          oldest = epoch;
+      }
+      auto keep = retired_.begin();
+      for (auto& retired : retired_)
+        if (retired.second > oldest)
+          *keep++ = std::move(retired);
+      retired_.erase(keep, retired_.end());
+    }
+
+  private:
+    static constexpr std::size_t kCacheLine = 64;
+    struct reader_slot {
+      std::atomic<std::uint64_t> epoch{0}; // 0 while not pinned
+      unsigned int depth{0}; // only touched by the owning thread
+      char pad_[kCacheLine - sizeof(std::atomic<std::uint64_t>) - sizeof(unsigned int)];
+    };
+
+    static constexpr std::size_t kShared = MaxReaders;
+
+    // a reader thread's slot, free again once the thread exits
+    class slot_lease {
+    public:
+      slot_lease() noexcept {
+        for (auto& in_use : slots_in_use_())
+          if (!in_use.exchange(true, std::memory_order_acquire))
+            break;
+          else
+            ++slot;
+      }
+      ~slot_lease() {
+        if (slot != kShared)
+          slots_in_use_()[slot].store(false, std::memory_order_release);
+      }
+      slot_lease(const slot_lease&) = delete;
+      slot_lease& operator=(const slot_lease&) = delete;
+      std::size_t slot{0};
+    };
+
+    static std::array<std::atomic<bool>, MaxReaders>& slots_in_use_() noexcept {
+      static std::array<std::atomic<bool>, MaxReaders> in_use{}; // zeroed: all free
+      return in_use;
+    }
+
+    static std::size_t reader_slot_() noexcept {
+      thread_local const slot_lease lease;
+      return lease.slot;
+    }
+
+    void unpin_(std::size_t slot) const noexcept {
+      auto& reader = readers_[slot];
+      if (slot == kShared) {
+        std::lock_guard<spinlock> lock(shared_lock_);
+        if (--reader.depth == 0)
+          reader.epoch.store(0, std::memory_order_release);
+        return;
+      }
+      if (--reader.depth == 0)
+        reader.epoch.store(0, std::memory_order_release);
+    }
+
+    std::atomic<const T*> current_{nullptr};
+    std::atomic<std::uint64_t> epoch_{1};
+    mutable std::array<reader_slot, MaxReaders + 1> readers_; // last is kShared
+    mutable spinlock shared_lock_;
+    std::shared_ptr<const T> owner_; // keeps current_ alive
+    std::vector<std::pair<std::shared_ptr<const T>, std::uint64_t>> retired_;
+  };
+
   static const std::string space = " \t\n\v\f\r";
   static const std::string blank = " \t";
   static const std::string digit = "0123456789";
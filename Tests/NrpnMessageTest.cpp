@@ -0,0 +1,72 @@
+/*
+  ==============================================================================
+
+    NrpnMessageTest.cpp
+
+This file is part of MIDI2LR. Copyright 2015-2016 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+// Checks that selecting an RPN ends a running NRPN parameter, so the data
+// entry meant for the RPN isn't read as NRPN values. Not part of the JUCE
+// projects; from the repository root:
+//   c++ -std=c++14 Tests/NrpnMessageTest.cpp Source/NrpnMessage.cpp -o nrpn_test
+// exits with 0 if every check passes
+#include <cstdio>
+#include "../Source/NrpnMessage.h"
+
+namespace {
+  int failures = 0;
+
+  void Check(bool passed, const char* what) {
+    if (!passed) {
+      std::printf("failed: %s\n", what);
+      ++failures;
+    }
+  }
+}
+
+int main() {
+  NRPN_Message message;
+  std::uint32_t time_ms = 0;
+
+  // NRPN 1/2 = 3/4
+  Check(message.ProcessMidi(99, 1, ++time_ms), "NRPN select MSB is consumed");
+  Check(message.ProcessMidi(98, 2, ++time_ms), "NRPN select LSB is consumed");
+  Check(message.ProcessMidi(6, 3, ++time_ms), "NRPN value MSB is consumed");
+  Check(message.ProcessMidi(38, 4, ++time_ms), "NRPN value LSB is consumed");
+  Check(message.IsReady(), "NRPN value is ready");
+  Check(message.GetControl() == (1 << 7) + 2, "NRPN parameter");
+  Check(message.GetValue() == (3 << 7) + 4, "NRPN value");
+  message.Clear();
+
+  // pitch-bend range (RPN 0/0) = 2 semitones, then a step up
+  Check(!message.ProcessMidi(101, 0, ++time_ms), "RPN select MSB passes through");
+  Check(!message.ProcessMidi(100, 0, ++time_ms), "RPN select LSB passes through");
+  Check(!message.ProcessMidi(6, 2, ++time_ms), "RPN data entry MSB passes through");
+  Check(!message.ProcessMidi(38, 0, ++time_ms), "RPN data entry LSB passes through");
+  Check(!message.ProcessMidi(96, 1, ++time_ms), "RPN data increment passes through");
+  Check(!message.IsInProcess(), "no NRPN value after the RPN");
+
+  // the NRPN must be selected again
+  Check(message.ProcessMidi(99, 1, ++time_ms), "NRPN reselect MSB is consumed");
+  Check(message.ProcessMidi(98, 2, ++time_ms), "NRPN reselect LSB is consumed");
+  Check(message.ProcessMidi(6, 5, ++time_ms), "NRPN value MSB is consumed again");
+  Check(message.ProcessMidi(38, 6, ++time_ms), "NRPN value LSB is consumed again");
+  Check(message.IsReady() && message.GetValue() == (5 << 7) + 6, "NRPN value again");
+
+  if (failures == 0)
+    std::printf("all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
\ No newline at end of file